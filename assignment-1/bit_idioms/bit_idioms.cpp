@@ -0,0 +1,440 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Riconoscimento degli idiomi di manipolazione dei bit, sostituiti dagli
+// intrinseci che diventano una sola istruzione:
+//   (x << k) | (x >> (32 - k))              -> fshl(x, x, k)
+//   scambio manuale dei byte                -> bswap(x)
+//   popcount "SWAR" con maschere 0x55...    -> ctpop(x)
+//   while (x) { x &= x - 1; c++; }          -> c += ctpop(x)
+//   while (x) { x >>= 1; c++; }             -> c += 32 - ctlz(x)
+//   while (!(x & 1)) { x >>= 1; c++; }      -> c += cttz(x)
+//   while (!(x & 0x80000000)) { x <<= 1; c++; } -> c += ctlz(x)
+namespace {
+
+// Loop di conteggio riconosciuti, distinti dall'operazione che avanza X a
+// ogni iterazione e dal test di uscita
+enum class CountingIdiom { ClearLowestBit, ShiftToZero, FindLowBit, FindHighBit };
+
+// Loop di conteggio su un blocco (ruotato, il test è su XNext) o su
+// header e body (il test è su X all'inizio dell'iterazione)
+struct CountingLoop {
+    BasicBlock *Header;
+    BasicBlock *Latch;
+    BasicBlock *Preheader;
+    BasicBlock *Exit;
+    PHINode *X;
+    PHINode *Count;
+    Instruction *XNext;
+    Instruction *CountNext;
+    CountingIdiom Idiom;
+    bool Rotated;
+};
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &) {
+    bool Transformed = false;
+  
+    for (auto &B : F) {
+      if (runOnBasicBlock(B)) {
+        Transformed = true;
+      }
+    }
+
+    // I loop riconosciuti vengono eliminati: i blocchi vanno raccolti prima
+    SmallVector<WeakVH, 16> Worklist;
+    for (auto &B : F) {
+      Worklist.push_back(&B);
+    }
+    for (WeakVH &V : Worklist) {
+      auto *B = dyn_cast_or_null<BasicBlock>(V);
+      CountingLoop CL;
+      if (B && matchCountingLoop(B, CL)) {
+        replaceCountingLoop(CL);
+        Transformed = true;
+      }
+    }
+
+    // Restituisci PreservedAnalyses::none() se ci sono state trasformazioni,
+    // altrimenti PreservedAnalyses::all().
+    return Transformed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+  }
+
+  bool runOnBasicBlock(BasicBlock &B) {
+    bool Transformed = false;
+
+    for (auto it = B.begin(); it != B.end(); ) {
+        Instruction *I = &*it++;
+
+        Value *Replacement = nullptr;
+        if (I->getOpcode() == Instruction::Or) {
+            // --- Rotazione: (x << k) | (x >> (32 - k)) ---
+            Replacement = matchRotate(I);
+
+            // --- Scambio dei byte: l'albero di or/shift/and viene
+            // riconosciuto da LLVM e sostituito con bswap. Si parte dalla
+            // radice dell'albero, non dagli or intermedi ---
+            SmallVector<Instruction *, 4> Inserted;
+            bool Root = I->use_empty() || any_of(I->users(), [](User *U) {
+                return cast<Instruction>(U)->getOpcode() != Instruction::Or;
+            });
+            if (!Replacement && Root && recognizeBSwapOrBitReverseIdiom(I, /*MatchBSwaps=*/true,
+                                                                /*MatchBitReversals=*/false, Inserted)) {
+                Replacement = Inserted.back();
+            }
+        } else if (I->getOpcode() == Instruction::LShr) {
+            // --- Popcount con maschere: l'ultimo passo è (v * 0x01010101) >> 24 ---
+            Replacement = matchPopCount(I);
+        }
+
+        if (!Replacement)
+            continue;
+
+        // Messaggio di debug
+        llvm::errs() << "Ottimizzazione: " << *I << " sostituito con " << *Replacement << "\n";
+
+        // Le istruzioni dell'idioma rimaste senza usi vengono eliminate:
+        // precedono I, quindi l'iteratore resta valido
+        I->replaceAllUsesWith(Replacement);
+        RecursivelyDeleteTriviallyDeadInstructions(I);
+        Transformed = true;
+    }
+
+    return Transformed;
+  }
+
+  // or(shl(x, a), lshr(x, b)) con a + b uguale alla larghezza del tipo:
+  // costanti, oppure b = larghezza - a (o viceversa)
+  Value *matchRotate(Instruction *I) {
+    Value *X, *ShlAmt, *ShrAmt;
+    if (!match(I, m_c_Or(m_Shl(m_Value(X), m_Value(ShlAmt)),
+                         m_LShr(m_Deferred(X), m_Value(ShrAmt)))))
+        return nullptr;
+
+    unsigned Width = I->getType()->getScalarSizeInBits();
+    Intrinsic::ID ID;
+    Value *Amt;
+    const APInt *A, *B;
+    if (match(ShlAmt, m_APInt(A)) && match(ShrAmt, m_APInt(B)) &&
+        A->ult(Width) && B->ult(Width) && *A + *B == Width) {
+        ID = Intrinsic::fshl;
+        Amt = ShlAmt;
+    } else if (match(ShrAmt, m_Sub(m_SpecificInt(Width), m_Specific(ShlAmt)))) {
+        ID = Intrinsic::fshl;
+        Amt = ShlAmt;
+    } else if (match(ShlAmt, m_Sub(m_SpecificInt(Width), m_Specific(ShrAmt)))) {
+        ID = Intrinsic::fshr;
+        Amt = ShrAmt;
+    } else {
+        return nullptr;
+    }
+
+    IRBuilder<> Builder(I);
+    return Builder.CreateIntrinsic(ID, {I->getType()}, {X, X, Amt});
+  }
+
+  // Popcount parallelo sui bit (per tipi di almeno 16 bit):
+  //   v = v - ((v >> 1) & 0x55555555);
+  //   v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+  //   v = (v + (v >> 4)) & 0x0F0F0F0F;
+  //   c = (v * 0x01010101) >> 24;
+  Value *matchPopCount(Instruction *I) {
+    Type *Ty = I->getType();
+    if (!Ty->isIntegerTy())
+        return nullptr;
+    unsigned Width = Ty->getIntegerBitWidth();
+    if (Width < 16 || Width > 128 || Width % 8 != 0)
+        return nullptr;
+
+    APInt Mask55 = APInt::getSplat(Width, APInt(8, 0x55));
+    APInt Mask33 = APInt::getSplat(Width, APInt(8, 0x33));
+    APInt Mask0F = APInt::getSplat(Width, APInt(8, 0x0F));
+    APInt Mask01 = APInt::getSplat(Width, APInt(8, 0x01));
+
+    Value *Bytes, *Nibbles, *Pairs, *Root, *Halved;
+    if (!match(I, m_LShr(m_Mul(m_Value(Bytes), m_SpecificInt(Mask01)), m_SpecificInt(Width - 8))) ||
+        !match(Bytes, m_And(m_c_Add(m_LShr(m_Value(Nibbles), m_SpecificInt(4)), m_Deferred(Nibbles)),
+                            m_SpecificInt(Mask0F))) ||
+        !match(Nibbles, m_c_Add(m_And(m_Value(Pairs), m_SpecificInt(Mask33)),
+                                m_And(m_LShr(m_Deferred(Pairs), m_SpecificInt(2)), m_SpecificInt(Mask33)))) ||
+        !match(Pairs, m_Sub(m_Value(Root), m_Value(Halved))) ||
+        !match(Halved, m_And(m_LShr(m_Specific(Root), m_SpecificInt(1)), m_SpecificInt(Mask55))))
+        return nullptr;
+
+    IRBuilder<> Builder(I);
+    return Builder.CreateUnaryIntrinsic(Intrinsic::ctpop, Root);
+  }
+
+  // Avanzamento di X in un'iterazione per ciascun idioma
+  Value *createStep(IRBuilder<> &Builder, CountingIdiom Idiom, Value *X) {
+    Type *Ty = X->getType();
+    switch (Idiom) {
+    case CountingIdiom::ClearLowestBit:
+        return Builder.CreateAnd(X, Builder.CreateAdd(X, ConstantInt::getAllOnesValue(Ty)));
+    case CountingIdiom::ShiftToZero:
+    case CountingIdiom::FindLowBit:
+        return Builder.CreateLShr(X, 1);
+    case CountingIdiom::FindHighBit:
+        return Builder.CreateShl(X, 1);
+    }
+    llvm_unreachable("idioma sconosciuto");
+  }
+
+  // Iterazioni di un loop che controlla X prima di ogni iterazione
+  Value *createIterationCount(IRBuilder<> &Builder, CountingIdiom Idiom, Value *X) {
+    Type *Ty = X->getType();
+    switch (Idiom) {
+    case CountingIdiom::ClearLowestBit:
+        return Builder.CreateUnaryIntrinsic(Intrinsic::ctpop, X);
+    case CountingIdiom::ShiftToZero:
+        return Builder.CreateSub(ConstantInt::get(Ty, Ty->getIntegerBitWidth()),
+                                 Builder.CreateBinaryIntrinsic(Intrinsic::ctlz, X, Builder.getFalse()));
+    case CountingIdiom::FindLowBit:
+        return Builder.CreateBinaryIntrinsic(Intrinsic::cttz, X, Builder.getFalse());
+    case CountingIdiom::FindHighBit:
+        return Builder.CreateBinaryIntrinsic(Intrinsic::ctlz, X, Builder.getFalse());
+    }
+    llvm_unreachable("idioma sconosciuto");
+  }
+
+  // Un loop che non termina per X = 0 (ricerca di un bit) può essere
+  // sostituito solo se il programma assume che i loop terminino
+  bool mustProgress(BasicBlock *Latch) {
+    if (Latch->getParent()->mustProgress())
+        return true;
+    MDNode *LoopID = Latch->getTerminator()->getMetadata(LLVMContext::MD_loop);
+    if (!LoopID)
+        return false;
+    for (const MDOperand &Op : LoopID->operands()) {
+        auto *MD = dyn_cast<MDNode>(Op.get());
+        auto *Name = MD && MD->getNumOperands() ? dyn_cast<MDString>(MD->getOperand(0)) : nullptr;
+        if (Name && Name->getString() == "llvm.loop.mustprogress")
+            return true;
+    }
+    return false;
+  }
+
+  bool matchCountingLoop(BasicBlock *H, CountingLoop &CL) {
+    // Forma del loop: o un unico blocco che salta a se stesso, o un header
+    // con il test e un body che torna all'header
+    auto *BI = dyn_cast<BranchInst>(H->getTerminator());
+    if (!BI || !BI->isConditional() || !H->hasNPredecessors(2))
+        return false;
+    BasicBlock *Latch = nullptr, *Exit = nullptr;
+    bool Rotated = false;
+    for (unsigned S = 0; S < 2; ++S) {
+        BasicBlock *Succ = BI->getSuccessor(S);
+        if (Succ == H) {
+            Latch = H;
+            Exit = BI->getSuccessor(1 - S);
+            Rotated = true;
+        } else if (Succ->getSinglePredecessor() == H && Succ->getSingleSuccessor() == H) {
+            Latch = Succ;
+            Exit = BI->getSuccessor(1 - S);
+            Rotated = false;
+        }
+    }
+    if (!Latch || Exit == H || Exit == Latch)
+        return false;
+    BasicBlock *Preheader = nullptr;
+    for (BasicBlock *Pred : predecessors(H))
+        if (Pred != Latch)
+            Preheader = Pred;
+    if (!Preheader || Preheader->getSingleSuccessor() != H)
+        return false;
+
+    // Esattamente due PHI: il valore su cui si itera e il contatore
+    SmallVector<PHINode *, 2> PHIs;
+    for (PHINode &PN : H->phis())
+        PHIs.push_back(&PN);
+    if (PHIs.size() != 2)
+        return false;
+
+    for (unsigned Idx = 0; Idx < 2; ++Idx) {
+        PHINode *X = PHIs[Idx];
+        PHINode *Count = PHIs[1 - Idx];
+        // Un loop su una lista (while (p) { p = p->next; n++; }) ha la
+        // stessa forma, ma X è un puntatore
+        if (!X->getType()->isIntegerTy())
+            continue;
+        auto *CountNext = dyn_cast<Instruction>(Count->getIncomingValueForBlock(Latch));
+        auto *XNext = dyn_cast<Instruction>(X->getIncomingValueForBlock(Latch));
+        if (!CountNext || !XNext || !match(CountNext, m_Add(m_Specific(Count), m_One())))
+            continue;
+
+        // Il test di uscita controlla il valore all'inizio dell'iterazione
+        // successiva: X nell'header, XNext nel loop ruotato
+        Value *Tested = Rotated ? static_cast<Value *>(XNext) : X;
+        ICmpInst::Predicate Pred;
+        Value *CmpOp;
+        if (!match(BI->getCondition(), m_ICmp(Pred, m_Value(CmpOp), m_Zero())) ||
+            !ICmpInst::isEquality(Pred))
+            continue;
+        // Il loop continua quando il confronto con zero è ContinueIfZero
+        bool ContinueIfZero = (Pred == ICmpInst::ICMP_EQ) == (BI->getSuccessor(0) != Exit);
+
+        SmallPtrSet<Instruction *, 8> Idiom{X, Count, XNext, CountNext, BI,
+                                            cast<Instruction>(BI->getCondition())};
+        Value *Dec;
+        unsigned Width = X->getType()->getIntegerBitWidth();
+        if (!ContinueIfZero && CmpOp == Tested &&
+            match(XNext, m_c_And(m_Specific(X), m_Value(Dec))) &&
+            (match(Dec, m_Add(m_Specific(X), m_AllOnes())) || match(Dec, m_Sub(m_Specific(X), m_One())))) {
+            CL.Idiom = CountingIdiom::ClearLowestBit;
+            Idiom.insert(cast<Instruction>(Dec));
+        } else if (!ContinueIfZero && CmpOp == Tested &&
+                   match(XNext, m_LShr(m_Specific(X), m_One()))) {
+            CL.Idiom = CountingIdiom::ShiftToZero;
+        } else if (ContinueIfZero && match(CmpOp, m_And(m_Specific(Tested), m_One())) &&
+                   match(XNext, m_LShr(m_Specific(X), m_One()))) {
+            CL.Idiom = CountingIdiom::FindLowBit;
+            Idiom.insert(cast<Instruction>(CmpOp));
+        } else if (ContinueIfZero &&
+                   match(CmpOp, m_And(m_Specific(Tested), m_SpecificInt(APInt::getSignMask(Width)))) &&
+                   match(XNext, m_Shl(m_Specific(X), m_One()))) {
+            CL.Idiom = CountingIdiom::FindHighBit;
+            Idiom.insert(cast<Instruction>(CmpOp));
+        } else {
+            continue;
+        }
+        if ((CL.Idiom == CountingIdiom::FindLowBit || CL.Idiom == CountingIdiom::FindHighBit) &&
+            !mustProgress(Latch))
+            continue;
+
+        // Il loop non deve fare altro, e dopo il loop servono solo X e il
+        // contatore così come sono all'uscita
+        bool Clean = true;
+        for (BasicBlock *B : {H, Latch}) {
+            for (Instruction &I : *B) {
+                if (!Idiom.count(&I) && !I.isTerminator())
+                    Clean = false;
+                for (User *U : I.users()) {
+                    auto *UI = cast<Instruction>(U);
+                    bool Outside = UI->getParent() != H && UI->getParent() != Latch;
+                    bool LiveOut = Rotated ? (&I == XNext || &I == CountNext) : (&I == X || &I == Count);
+                    if (Outside && !LiveOut)
+                        Clean = false;
+                }
+            }
+        }
+        if (!Clean)
+            continue;
+
+        CL = {H, Latch, Preheader, Exit, X, Count, XNext, CountNext, CL.Idiom, Rotated};
+        return true;
+    }
+    return false;
+  }
+
+  void replaceCountingLoop(CountingLoop &CL) {
+    // Il numero di iterazioni si calcola nel preheader. Il loop ruotato
+    // esegue sempre la prima iterazione, poi si comporta come il loop con
+    // il test in testa a partire da X avanzato di un passo.
+    IRBuilder<> Builder(CL.Preheader->getTerminator());
+    Value *X0 = CL.X->getIncomingValueForBlock(CL.Preheader);
+    Value *Count0 = CL.Count->getIncomingValueForBlock(CL.Preheader);
+    Type *Ty = X0->getType();
+    Value *N;
+    if (CL.Rotated) {
+        Value *X1 = createStep(Builder, CL.Idiom, X0);
+        N = Builder.CreateAdd(createIterationCount(Builder, CL.Idiom, X1), ConstantInt::get(Ty, 1));
+    } else {
+        N = createIterationCount(Builder, CL.Idiom, X0);
+    }
+    // N ha il tipo di X e serve così per gli shift; il contatore può avere
+    // un'altra larghezza (uint64_t x con un contatore int)
+    Value *CountN = Builder.CreateZExtOrTrunc(N, Count0->getType());
+    Value *FinalCount = match(Count0, m_Zero()) ? CountN
+                                                : Builder.CreateAdd(Count0, CountN, CL.Count->getName() + ".final");
+    Value *FinalX;
+    switch (CL.Idiom) {
+    case CountingIdiom::ClearLowestBit:
+    case CountingIdiom::ShiftToZero:
+        FinalX = ConstantInt::get(Ty, 0);
+        break;
+    case CountingIdiom::FindLowBit:
+        FinalX = Builder.CreateLShr(X0, N);
+        break;
+    case CountingIdiom::FindHighBit:
+        FinalX = Builder.CreateShl(X0, N);
+        break;
+    }
+
+    llvm::errs() << "Ottimizzazione: loop " << CL.Header->getName() << " sostituito con "
+                 << *N << "\n";
+
+    // Gli usi dopo il loop leggono i valori finali; le PHI dell'uscita li
+    // ricevono dal preheader, che salta direttamente all'uscita
+    Value *LiveX = CL.Rotated ? static_cast<Value *>(CL.XNext) : CL.X;
+    Value *LiveCount = CL.Rotated ? static_cast<Value *>(CL.CountNext) : CL.Count;
+    auto Final = [&](Value *V) { return V == LiveX ? FinalX : V == LiveCount ? FinalCount : V; };
+    for (PHINode &PN : CL.Exit->phis())
+        PN.addIncoming(Final(PN.getIncomingValueForBlock(CL.Header)), CL.Preheader);
+    for (Value *V : {LiveX, LiveCount}) {
+        for (Use &U : make_early_inc_range(V->uses())) {
+            auto *UI = cast<Instruction>(U.getUser());
+            if (UI->getParent() != CL.Header && UI->getParent() != CL.Latch && !isa<PHINode>(UI))
+                U.set(Final(V));
+            else if (auto *PN = dyn_cast<PHINode>(UI); PN && PN->getParent() != CL.Header &&
+                                                      PN->getParent() != CL.Exit)
+                U.set(Final(V));
+        }
+    }
+
+    RecursivelyDeleteTriviallyDeadInstructions(FinalX);
+
+    CL.Preheader->getTerminator()->replaceUsesOfWith(CL.Header, CL.Exit);
+    SmallVector<BasicBlock *, 2> Dead{CL.Header};
+    if (CL.Latch != CL.Header)
+        Dead.push_back(CL.Latch);
+    DeleteDeadBlocks(Dead);
+  }
+
+  // Questo pass è richiesto per le funzioni con l'attributo optnone
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "localOpts", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "local-opts") {
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
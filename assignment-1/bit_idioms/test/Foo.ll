@@ -0,0 +1,267 @@
+define dso_local i32 @rot(i32 noundef %0, i32 noundef %1) #0 {
+  ; Caso 1: (x << 7) | (x >> 25) (dovrebbe diventare fshl(x, x, 7))
+  %shl1 = shl i32 %0, 7
+  %shr1 = lshr i32 %0, 25
+  %rot1 = or i32 %shl1, %shr1
+
+  ; Caso 2: (x << k) | (x >> (32 - k)) (dovrebbe diventare fshl(x, x, k))
+  %k = and i32 %1, 31
+  %sub2 = sub i32 32, %k
+  %shl2 = shl i32 %0, %k
+  %shr2 = lshr i32 %0, %sub2
+  %rot2 = or i32 %shr2, %shl2
+
+  ; Caso 3: (x >> k) | (x << (32 - k)) (dovrebbe diventare fshr(x, x, k))
+  %shr3 = lshr i32 %0, %k
+  %shl3 = shl i32 %0, %sub2
+  %rot3 = or i32 %shr3, %shl3
+
+  ; Caso 4: (x << 7) | (x >> 24) (non è una rotazione, nessuna ottimizzazione)
+  %shr4 = lshr i32 %0, 24
+  %or4 = or i32 %shl1, %shr4
+
+  %tmp1 = xor i32 %rot1, %rot2
+  %tmp2 = xor i32 %tmp1, %rot3
+  %result = xor i32 %tmp2, %or4
+  ret i32 %result
+}
+
+define dso_local i32 @swap(i32 noundef %0) #0 {
+  ; Caso 5: scambio manuale dei byte (dovrebbe diventare bswap(x))
+  %b0 = shl i32 %0, 24
+  %t1 = shl i32 %0, 8
+  %b1 = and i32 %t1, 16711680
+  %t2 = lshr i32 %0, 8
+  %b2 = and i32 %t2, 65280
+  %b3 = lshr i32 %0, 24
+  %or1 = or i32 %b0, %b1
+  %or2 = or i32 %or1, %b2
+  %or3 = or i32 %or2, %b3
+  ret i32 %or3
+}
+
+define dso_local i32 @swar(i32 noundef %0) #0 {
+  ; Caso 6: popcount con maschere (dovrebbe diventare ctpop(x))
+  %h = lshr i32 %0, 1
+  %m1 = and i32 %h, 1431655765
+  %v1 = sub i32 %0, %m1
+  %a = and i32 %v1, 858993459
+  %s2 = lshr i32 %v1, 2
+  %b = and i32 %s2, 858993459
+  %v2 = add i32 %a, %b
+  %s4 = lshr i32 %v2, 4
+  %v3 = add i32 %v2, %s4
+  %v4 = and i32 %v3, 252645135
+  %mul = mul i32 %v4, 16843009
+  %c = lshr i32 %mul, 24
+  ret i32 %c
+}
+
+define dso_local i32 @popcount(i32 noundef %0) #0 {
+entry:
+  br label %header
+
+  ; Caso 7: while (x) { x &= x - 1; c++; } (dovrebbe diventare ctpop(x))
+header:
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %cmp = icmp ne i32 %x, 0
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %dec = add i32 %x, -1
+  %x.next = and i32 %x, %dec
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:
+  ret i32 %c
+}
+
+define dso_local i32 @bitlength(i32 noundef %0) #0 {
+entry:
+  %nz = icmp eq i32 %0, 0
+  br i1 %nz, label %exit, label %loop.pre
+
+loop.pre:
+  br label %loop
+
+  ; Caso 8: do { x >>= 1; c++; } while (x) (ruotato, dovrebbe diventare
+  ; 1 + (32 - ctlz(x >> 1)))
+loop:
+  %x = phi i32 [ %0, %loop.pre ], [ %x.next, %loop ]
+  %c = phi i32 [ 0, %loop.pre ], [ %c.next, %loop ]
+  %x.next = lshr i32 %x, 1
+  %c.next = add nuw nsw i32 %c, 1
+  %cmp = icmp eq i32 %x.next, 0
+  br i1 %cmp, label %loop.exit, label %loop
+
+loop.exit:
+  %c.lcssa = phi i32 [ %c.next, %loop ]
+  br label %exit
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %c.lcssa, %loop.exit ]
+  ret i32 %r
+}
+
+define dso_local i32 @trailing(i32 noundef %0) #1 {
+entry:
+  br label %header
+
+  ; Caso 9: while (!(x & 1)) { x >>= 1; c++; } (dovrebbe diventare cttz(x),
+  ; la funzione è mustprogress)
+header:
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %low = and i32 %x, 1
+  %cmp = icmp eq i32 %low, 0
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %x.next = lshr i32 %x, 1
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:
+  %r = add i32 %c, %x
+  ret i32 %r
+}
+
+define dso_local i32 @leading(i32 noundef %0) #1 {
+entry:
+  br label %header
+
+  ; Caso 10: while (!(x & 0x80000000)) { x <<= 1; c++; } (dovrebbe
+  ; diventare ctlz(x), la funzione è mustprogress)
+header:
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %high = and i32 %x, -2147483648
+  %cmp = icmp eq i32 %high, 0
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %x.next = shl i32 %x, 1
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:
+  ret i32 %c
+}
+
+define dso_local i32 @leading_noprogress(i32 noundef %0) #0 {
+entry:
+  br label %header
+
+  ; Caso 11: come il caso 10, ma senza mustprogress il loop non termina per
+  ; x = 0 e va lasciato (nessuna ottimizzazione)
+header:
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %high = and i32 %x, -2147483648
+  %cmp = icmp eq i32 %high, 0
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %x.next = shl i32 %x, 1
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:
+  ret i32 %c
+}
+
+define dso_local i32 @popcount_sum(i32 noundef %0, ptr noundef %1) #0 {
+entry:
+  br label %header
+
+  ; Caso 12: il loop scrive in memoria a ogni iterazione (nessuna
+  ; ottimizzazione)
+header:
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %cmp = icmp ne i32 %x, 0
+  br i1 %cmp, label %body, label %exit
+
+body:
+  store i32 %x, ptr %1, align 4
+  %dec = add i32 %x, -1
+  %x.next = and i32 %x, %dec
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:
+  ret i32 %c
+}
+
+define dso_local i32 @trailing_wide(i64 noundef %0) #1 {
+entry:
+  br label %header
+
+  ; Caso 13: come il caso 9 con uint64_t x e int c (dovrebbe diventare
+  ; cttz(x) a 64 bit, troncato solo per il contatore)
+header:
+  %x = phi i64 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %low = and i64 %x, 1
+  %cmp = icmp eq i64 %low, 0
+  br i1 %cmp, label %body, label %exit
+
+body:
+  %x.next = lshr i64 %x, 1
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:
+  %xt = trunc i64 %x to i32
+  %r = add i32 %c, %xt
+  ret i32 %r
+}
+
+define dso_local i32 @popcount_o0(i32 noundef %0) #0 {
+  br label %2
+
+  ; Caso 14: while (x) { x &= x - 1; c++; } come esce da clang -O0 e
+  ; mem2reg, con sub x, 1 al posto di add x, -1 (dovrebbe diventare ctpop(x))
+2:
+  %.01 = phi i32 [ 0, %1 ], [ %7, %4 ]
+  %.0 = phi i32 [ %0, %1 ], [ %6, %4 ]
+  %3 = icmp ne i32 %.0, 0
+  br i1 %3, label %4, label %8
+
+4:
+  %5 = sub i32 %.0, 1
+  %6 = and i32 %.0, %5
+  %7 = add nsw i32 %.01, 1
+  br label %2
+
+8:
+  ret i32 %.01
+}
+
+%struct.node = type { i32, ptr }
+
+define dso_local i32 @list_length(ptr noundef %0) #0 {
+  br label %2
+
+  ; Caso 15: while (p) { p = p->next; n++; }, stessa forma dei loop di
+  ; conteggio ma su un puntatore (nessuna ottimizzazione)
+2:
+  %.01 = phi i32 [ 0, %1 ], [ %7, %4 ]
+  %.0 = phi ptr [ %0, %1 ], [ %6, %4 ]
+  %3 = icmp ne ptr %.0, null
+  br i1 %3, label %4, label %8
+
+4:
+  %5 = getelementptr inbounds %struct.node, ptr %.0, i32 0, i32 1
+  %6 = load ptr, ptr %5, align 8
+  %7 = add nsw i32 %.01, 1
+  br label %2
+
+8:
+  ret i32 %.01
+}
+
+attributes #0 = { noinline nounwind uwtable }
+attributes #1 = { mustprogress noinline nounwind uwtable }
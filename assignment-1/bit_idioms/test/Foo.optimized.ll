@@ -0,0 +1,195 @@
+; ModuleID = 'Foo.optimized.bc'
+source_filename = "Foo.ll"
+
+%struct.node = type { i32, ptr }
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @rot(i32 noundef %0, i32 noundef %1) #0 {
+  %shl1 = shl i32 %0, 7
+  %3 = call i32 @llvm.fshl.i32(i32 %0, i32 %0, i32 7)
+  %k = and i32 %1, 31
+  %4 = call i32 @llvm.fshl.i32(i32 %0, i32 %0, i32 %k)
+  %5 = call i32 @llvm.fshr.i32(i32 %0, i32 %0, i32 %k)
+  %shr4 = lshr i32 %0, 24
+  %or4 = or i32 %shl1, %shr4
+  %tmp1 = xor i32 %3, %4
+  %tmp2 = xor i32 %tmp1, %5
+  %result = xor i32 %tmp2, %or4
+  ret i32 %result
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @swap(i32 noundef %0) #0 {
+  %rev = call i32 @llvm.bswap.i32(i32 %0)
+  ret i32 %rev
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @swar(i32 noundef %0) #0 {
+  %2 = call i32 @llvm.ctpop.i32(i32 %0)
+  ret i32 %2
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @popcount(i32 noundef %0) #0 {
+entry:
+  %1 = call i32 @llvm.ctpop.i32(i32 %0)
+  br label %exit
+
+exit:                                             ; preds = %entry
+  ret i32 %1
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @bitlength(i32 noundef %0) #0 {
+entry:
+  %nz = icmp eq i32 %0, 0
+  br i1 %nz, label %exit, label %loop.pre
+
+loop.pre:                                         ; preds = %entry
+  %1 = lshr i32 %0, 1
+  %2 = call i32 @llvm.ctlz.i32(i32 %1, i1 false)
+  %3 = sub i32 32, %2
+  %4 = add i32 %3, 1
+  br label %loop.exit
+
+loop.exit:                                        ; preds = %loop.pre
+  br label %exit
+
+exit:                                             ; preds = %loop.exit, %entry
+  %r = phi i32 [ 0, %entry ], [ %4, %loop.exit ]
+  ret i32 %r
+}
+
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local i32 @trailing(i32 noundef %0) #1 {
+entry:
+  %1 = call i32 @llvm.cttz.i32(i32 %0, i1 false)
+  %2 = lshr i32 %0, %1
+  br label %exit
+
+exit:                                             ; preds = %entry
+  %r = add i32 %1, %2
+  ret i32 %r
+}
+
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local i32 @leading(i32 noundef %0) #1 {
+entry:
+  %1 = call i32 @llvm.ctlz.i32(i32 %0, i1 false)
+  br label %exit
+
+exit:                                             ; preds = %entry
+  ret i32 %1
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @leading_noprogress(i32 noundef %0) #0 {
+entry:
+  br label %header
+
+header:                                           ; preds = %body, %entry
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %high = and i32 %x, -2147483648
+  %cmp = icmp eq i32 %high, 0
+  br i1 %cmp, label %body, label %exit
+
+body:                                             ; preds = %header
+  %x.next = shl i32 %x, 1
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:                                             ; preds = %header
+  ret i32 %c
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @popcount_sum(i32 noundef %0, ptr noundef %1) #0 {
+entry:
+  br label %header
+
+header:                                           ; preds = %body, %entry
+  %x = phi i32 [ %0, %entry ], [ %x.next, %body ]
+  %c = phi i32 [ 0, %entry ], [ %c.next, %body ]
+  %cmp = icmp ne i32 %x, 0
+  br i1 %cmp, label %body, label %exit
+
+body:                                             ; preds = %header
+  store i32 %x, ptr %1, align 4
+  %dec = add i32 %x, -1
+  %x.next = and i32 %x, %dec
+  %c.next = add i32 %c, 1
+  br label %header
+
+exit:                                             ; preds = %header
+  ret i32 %c
+}
+
+; Function Attrs: mustprogress noinline nounwind uwtable
+define dso_local i32 @trailing_wide(i64 noundef %0) #1 {
+entry:
+  %1 = call i64 @llvm.cttz.i64(i64 %0, i1 false)
+  %2 = trunc i64 %1 to i32
+  %3 = lshr i64 %0, %1
+  br label %exit
+
+exit:                                             ; preds = %entry
+  %xt = trunc i64 %3 to i32
+  %r = add i32 %2, %xt
+  ret i32 %r
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @popcount_o0(i32 noundef %0) #0 {
+  %2 = call i32 @llvm.ctpop.i32(i32 %0)
+  br label %3
+
+3:                                                ; preds = %1
+  ret i32 %2
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @list_length(ptr noundef %0) #0 {
+  br label %2
+
+2:                                                ; preds = %4, %1
+  %.01 = phi i32 [ 0, %1 ], [ %7, %4 ]
+  %.0 = phi ptr [ %0, %1 ], [ %6, %4 ]
+  %3 = icmp ne ptr %.0, null
+  br i1 %3, label %4, label %8
+
+4:                                                ; preds = %2
+  %5 = getelementptr inbounds %struct.node, ptr %.0, i32 0, i32 1
+  %6 = load ptr, ptr %5, align 8
+  %7 = add nsw i32 %.01, 1
+  br label %2
+
+8:                                                ; preds = %2
+  ret i32 %.01
+}
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.fshl.i32(i32, i32, i32) #2
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.fshr.i32(i32, i32, i32) #2
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.bswap.i32(i32) #2
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.ctpop.i32(i32) #2
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.ctlz.i32(i32, i1 immarg) #2
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i32 @llvm.cttz.i32(i32, i1 immarg) #2
+
+; Function Attrs: nofree nosync nounwind readnone speculatable willreturn
+declare i64 @llvm.cttz.i64(i64, i1 immarg) #2
+
+attributes #0 = { noinline nounwind uwtable }
+attributes #1 = { mustprogress noinline nounwind uwtable }
+attributes #2 = { nofree nosync nounwind readnone speculatable willreturn }
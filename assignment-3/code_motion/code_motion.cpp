@@ -6,7 +6,16 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/MemorySSAUpdater.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/ADT/MapVector.h"
+#include <map>
+#include <memory>
 #include <set>
 
 using namespace llvm;
@@ -16,53 +25,302 @@ using namespace llvm;
 //-----------------------------------------------------------------------------
 namespace {
 
+// Riscrive load e store di una variabile del loop come valori SSA e, prima di
+// cancellarli, inserisce in ogni uscita un solo store del valore finale
+struct StorePromoter : LoadAndStorePromoter {
+  Loop *L;
+  AllocaInst *AI;
+  const SmallVectorImpl<BasicBlock *> &ExitBlocks;
+  MemorySSAUpdater *MSSAU;
+  SSAUpdater &SSA;
+
+  StorePromoter(ArrayRef<const Instruction *> Insts, SSAUpdater &S, Loop *L, AllocaInst *AI,
+                const SmallVectorImpl<BasicBlock *> &ExitBlocks, MemorySSAUpdater *MSSAU)
+      : LoadAndStorePromoter(Insts, S, AI->getName()), L(L), AI(AI), ExitBlocks(ExitBlocks), MSSAU(MSSAU), SSA(S) {}
+
+  void doExtraRewritesBeforeFinalDeletion() override {
+    for (BasicBlock *Exit : ExitBlocks) {
+        // La PHI creata dall'SSAUpdater unisce i valori che escono dal loop
+        Value *Final = SSA.GetValueInMiddleOfBlock(Exit);
+        // Con un solo predecessore l'SSAUpdater restituisce direttamente il
+        // valore del loop: come in LICM serve una PHI LCSSA nell'uscita
+        if (auto *I = dyn_cast<Instruction>(Final); I && L->contains(I)) {
+            PHINode *PN = PHINode::Create(I->getType(), pred_size(Exit), I->getName() + ".lcssa", &Exit->front());
+            for (BasicBlock *Pred : predecessors(Exit)) {
+                PN->addIncoming(I, Pred);
+            }
+            Final = PN;
+        }
+        auto *Store = new StoreInst(Final, AI, &*Exit->getFirstInsertionPt());
+        Store->setAlignment(AI->getAlign());
+        errs() << "Inserted " << *Store << " in exit block " << Exit->getName() << "\n";
+        if (MSSAU) {
+            MemoryAccess *MA = MSSAU->createMemoryAccessInBB(Store, nullptr, Exit, MemorySSA::Beginning);
+            MSSAU->insertDef(cast<MemoryDef>(MA), /*RenameUses=*/true);
+        }
+    }
+  }
+
+  void instructionDeleted(Instruction *I) const override {
+    if (MSSAU) {
+        MSSAU->removeMemoryAccess(I);
+    }
+  }
+};
+
 struct TestPass : PassInfoMixin<TestPass> {
+  // Store del loop corrente raggruppati per oggetto sottostante
+  MapVector<const Value *, SmallVector<StoreInst *, 4>> StoreIndex;
+
   // Main entry point per il nuovo Pass Manager
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
     // Ottieni LoopInfo e DominatorTree
     auto &LI = FAM.getResult<LoopAnalysis>(F);
     auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
 
+    // MemorySSA viene aggiornata solo se qualcuno l'ha già calcolata
+    std::unique_ptr<MemorySSAUpdater> MSSAU;
+    if (auto *MSSAResult = FAM.getCachedResult<MemorySSAAnalysis>(F)) {
+        MSSAU = std::make_unique<MemorySSAUpdater>(&MSSAResult->getMSSA());
+    }
+
     bool Changed = false;
 
     // Itera su tutti i loop nella funzione
     for (Loop *L : LI) {
-        // Ottieni il preheader del loop
-        BasicBlock *Preheader = L->getLoopPreheader();
-        if (!Preheader) {
-            errs() << "Loop senza preheader, skipping.\n";
-            continue;
+        if (runOnLoop(L, DT, MSSAU.get())) {
+            Changed = true;
         }
+    }
 
-        // Trova le uscite del loop
-        SmallVector<BasicBlock *, 4> ExitBlocks;
-        L->getExitBlocks(ExitBlocks);
+    if (!Changed) {
+        return PreservedAnalyses::all();
+    }
+    return getPreservedAnalyses(MSSAU != nullptr);
+  }
 
-        std::set<Instruction *> MovedInstructions;
-        
-        // Esegui una ricerca depth-first sui blocchi del loop
-        for (BasicBlock *BB : L->blocks()) {
-            std::vector<Instruction*> ToMove;
+  // Hoisting e sinking spostano solo istruzioni, senza toccare il CFG: le
+  // analisi sul CFG restano valide e non vanno ricalcolate dai pass successivi
+  static PreservedAnalyses getPreservedAnalyses(bool PreserveMSSA) {
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    PA.preserve<LoopAnalysis>();
+    PA.preserve<DominatorTreeAnalysis>();
+    if (PreserveMSSA) {
+        PA.preserve<MemorySSAAnalysis>();
+    }
+    return PA;
+  }
 
-            for (Instruction &I : *BB) {
-                if (isCandidateForCodeMotion(I, L, BB, ExitBlocks, DT, MovedInstructions)) {
-                    ToMove.push_back(&I);
-                }
+  bool runOnLoop(Loop *L, DominatorTree &DT, MemorySSAUpdater *MSSAU) {
+    bool Changed = false;
+
+    // Ottieni il preheader del loop
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (!Preheader) {
+        errs() << "Loop senza preheader, skipping.\n";
+        return false;
+    }
+
+    // Trova le uscite del loop
+    SmallVector<BasicBlock *, 4> ExitBlocks;
+    L->getExitBlocks(ExitBlocks);
+
+    // Indice degli store del loop, costruito una sola volta per loop
+    buildStoreIndex(L);
+
+    std::set<Instruction *> MovedInstructions;
+
+    // Esegui una ricerca depth-first sui blocchi del loop
+    for (BasicBlock *BB : L->blocks()) {
+        std::vector<Instruction*> ToMove;
+
+        for (Instruction &I : *BB) {
+            if (isCandidateForCodeMotion(I, L, BB, ExitBlocks, DT, MovedInstructions)) {
+                ToMove.push_back(&I);
             }
+        }
 
-            for (Instruction *I : ToMove) {
-                errs() << "Moving instruction: " << *I << " to the preheader of the loop.\n";
-                I->moveBefore(Preheader->getTerminator());
-                MovedInstructions.insert(I);
-                errs() << "The instruction has been moved correctly.\n";
-                Changed = true;
+        for (Instruction *I : ToMove) {
+            errs() << "Moving instruction: " << *I << " to the preheader of the loop.\n";
+            I->moveBefore(Preheader->getTerminator());
+            if (MSSAU) {
+                if (MemoryUseOrDef *MA = MSSAU->getMemorySSA()->getMemoryAccess(I)) {
+                    MSSAU->moveToPlace(MA, Preheader, MemorySSA::BeforeTerminator);
+                }
             }
+            MovedInstructions.insert(I);
+            errs() << "The instruction has been moved correctly.\n";
+            Changed = true;
         }
     }
 
-    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    // Seconda fase: affonda nelle uscite i valori usati solo fuori dal loop
+    if (sinkToExitBlocks(L, ExitBlocks, DT, MSSAU)) {
+        Changed = true;
+    }
+
+    // Terza fase: gli store a indirizzo invariante diventano un solo store
+    // per uscita del valore finale
+    if (sinkInvariantStores(L, ExitBlocks, MSSAU)) {
+        Changed = true;
+    }
+
+    return Changed;
   }
 
+// Sposta nei blocchi di uscita le istruzioni i cui utenti sono tutti fuori dal
+// loop: invece di essere ricalcolate ad ogni iterazione vengono calcolate una
+// sola volta, con una copia per ogni uscita in cui il valore serve.
+bool sinkToExitBlocks(Loop *L, const SmallVectorImpl<BasicBlock *> &ExitBlocks, DominatorTree &DT, MemorySSAUpdater *MSSAU) {
+    // Le uscite devono avere predecessori solo nel loop, altrimenti la copia
+    // verrebbe eseguita anche su cammini che non attraversano il loop
+    if (ExitBlocks.empty() || !L->hasDedicatedExits()) {
+        errs() << "[DEBUG] Loop senza uscite dedicate, niente sinking.\n";
+        return false;
+    }
+
+    bool Changed = false;
+
+    // Visita dal basso verso l'alto: così anche le catene di istruzioni
+    // (t = a * b; u = t + 1) vengono affondate in un solo passaggio
+    std::vector<BasicBlock *> Blocks(L->blocks().begin(), L->blocks().end());
+    for (auto BI = Blocks.rbegin(); BI != Blocks.rend(); ++BI) {
+        BasicBlock *BB = *BI;
+        for (auto II = BB->rbegin(); II != BB->rend(); ) {
+            Instruction &I = *II++;
+            if (!isCandidateForSinking(I, L, ExitBlocks, DT))
+                continue;
+            sinkInstruction(I, L, ExitBlocks, DT, MSSAU);
+            Changed = true;
+        }
+    }
+    return Changed;
+}
+
+// Trova l'uscita a cui appartiene un uso esterno al loop. Per le PHI conta
+// l'arco entrante, non il blocco della PHI.
+BasicBlock *getExitForUse(Use &U, Loop *L, const SmallVectorImpl<BasicBlock *> &ExitBlocks, DominatorTree &DT) {
+    auto *UserInst = cast<Instruction>(U.getUser());
+    BasicBlock *UseBB = UserInst->getParent();
+    if (auto *PN = dyn_cast<PHINode>(UserInst)) {
+        BasicBlock *Incoming = PN->getIncomingBlock(U);
+        if (L->contains(Incoming)) {
+            return UseBB;
+        }
+        UseBB = Incoming;
+    }
+    for (BasicBlock *Exit : ExitBlocks) {
+        if (DT.dominates(Exit, UseBB)) {
+            return Exit;
+        }
+    }
+    return nullptr;
+}
+
+bool isCandidateForSinking(Instruction &I, Loop *L, const SmallVectorImpl<BasicBlock *> &ExitBlocks, DominatorTree &DT) {
+    if (isa<PHINode>(&I) || I.isTerminator()) return false;
+    if (isa<AllocaInst>(&I) || I.isEHPad()) return false;
+    if (I.mayHaveSideEffects() || I.mayReadFromMemory()) return false;
+    if (I.use_empty()) return false;
+
+    for (Use &U : I.uses()) {
+        auto *UserInst = dyn_cast<Instruction>(U.getUser());
+        if (!UserInst) {
+            return false;
+        }
+        // Un utente dentro il loop richiede il valore ad ogni iterazione
+        if (L->contains(UserInst->getParent())) {
+            errs() << "[DEBUG] " << I << " è usata nel loop, niente sinking.\n";
+            return false;
+        }
+        // Una PHI d'uscita che mescola altri valori non si può sostituire
+        if (auto *PN = dyn_cast<PHINode>(UserInst)) {
+            if (L->contains(PN->getIncomingBlock(U))) {
+                for (Value *In : PN->incoming_values()) {
+                    if (In != &I) {
+                        errs() << "[DEBUG] PHI d'uscita " << *PN << " non è LCSSA, niente sinking.\n";
+                        return false;
+                    }
+                }
+            }
+        }
+        BasicBlock *Exit = getExitForUse(U, L, ExitBlocks, DT);
+        if (!Exit) {
+            errs() << "[DEBUG] Uso di " << I << " non dominato da un'uscita.\n";
+            return false;
+        }
+        // La copia nell'uscita vede gli stessi operandi solo se l'istruzione
+        // viene eseguita su ogni cammino che porta a quell'uscita
+        if (!DT.dominates(I.getParent(), Exit)) {
+            errs() << "[DEBUG] " << I << " non domina l'uscita " << Exit->getName() << "\n";
+            return false;
+        }
+    }
+    errs() << "[DEBUG] Istruzione candidata per il sinking: " << I << "\n";
+    return true;
+}
+
+// Crea la copia di I all'inizio di Exit. Gli operandi definiti nel loop
+// passano da PHI LCSSA, così la forma LCSSA del loop resta valida.
+Instruction *cloneIntoExit(Instruction &I, Loop *L, BasicBlock *Exit) {
+    Instruction *Clone = I.clone();
+    Clone->setName(I.getName() + ".sink");
+    Clone->insertBefore(&*Exit->getFirstInsertionPt());
+
+    for (Use &Op : Clone->operands()) {
+        auto *OpInst = dyn_cast<Instruction>(Op.get());
+        if (!OpInst || !L->contains(OpInst->getParent())) {
+            continue;
+        }
+        PHINode *PN = PHINode::Create(OpInst->getType(), pred_size(Exit),
+                                      OpInst->getName() + ".lcssa", &Exit->front());
+        for (BasicBlock *Pred : predecessors(Exit)) {
+            PN->addIncoming(OpInst, Pred);
+        }
+        Op.set(PN);
+    }
+
+    errs() << "Sinking instruction: " << I << " into exit block " << Exit->getName() << "\n";
+    return Clone;
+}
+
+void sinkInstruction(Instruction &I, Loop *L, const SmallVectorImpl<BasicBlock *> &ExitBlocks, DominatorTree &DT, MemorySSAUpdater *MSSAU) {
+    // Una copia per ogni uscita in cui il valore è usato
+    std::map<BasicBlock *, Instruction *> Clones;
+    std::set<PHINode *> ExitPHIs;
+
+    SmallVector<Use *, 8> Uses;
+    for (Use &U : I.uses()) {
+        Uses.push_back(&U);
+    }
+
+    for (Use *U : Uses) {
+        BasicBlock *Exit = getExitForUse(*U, L, ExitBlocks, DT);
+        Instruction *&Clone = Clones[Exit];
+        if (!Clone) {
+            Clone = cloneIntoExit(I, L, Exit);
+        }
+
+        // Le PHI LCSSA dell'uscita vengono sostituite interamente dalla copia
+        auto *PN = dyn_cast<PHINode>(U->getUser());
+        if (PN && L->contains(PN->getIncomingBlock(*U))) {
+            ExitPHIs.insert(PN);
+            continue;
+        }
+        U->set(Clone);
+    }
+
+    for (PHINode *PN : ExitPHIs) {
+        PN->replaceAllUsesWith(Clones[PN->getParent()]);
+        PN->eraseFromParent();
+    }
+    if (MSSAU) {
+        MSSAU->removeMemoryAccess(&I);
+    }
+    I.eraseFromParent();
+}
+
   // Funzione per verificare se un'istruzione è loop-invariant
 bool isLoopInvariant(Instruction &I, Loop *L, DominatorTree &DT) {
     errs() << "[DEBUG] Controllo loop-invariance per: " << I << "\n";
@@ -107,23 +365,107 @@ bool dominatesAllExits(BasicBlock *BB, const SmallVectorImpl<BasicBlock *> &Exit
     return true;
 }
 
-bool isReassignedInLoop(Instruction &I, Loop *L) {
-    errs() << "[DEBUG] Controllo se l'istruzione è riscritta nel loop: " << I << "\n";
-    if (StoreInst *Store = dyn_cast<StoreInst>(&I)) {
-        Value *Ptr = Store->getPointerOperand();
-        for (BasicBlock *BB : L->blocks()) {
-            for (Instruction &Inst : *BB) {
-                if (&Inst != &I && isa<StoreInst>(&Inst)) {
-                    if (cast<StoreInst>(&Inst)->getPointerOperand() == Ptr) {
-                        errs() << "[DEBUG] Trovata riscrittura su " << *Ptr << " in " << Inst << "\n";
-                        return true;
-                    }
-                }
+// Raggruppa gli store del loop per oggetto sottostante: le domande "chi
+// altro scrive su questo indirizzo?" guardano solo il gruppo giusto invece
+// di riscandire tutto il loop per ogni store
+void buildStoreIndex(Loop *L) {
+    StoreIndex.clear();
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &Inst : *BB) {
+            if (auto *Store = dyn_cast<StoreInst>(&Inst)) {
+                const Value *Object = getUnderlyingObject(Store->getPointerOperand());
+                StoreIndex[Object].push_back(Store);
+            }
+        }
+    }
+}
+
+// Una variabile locale il cui indirizzo non esce mai dalla funzione: nessuna
+// chiamata o altro puntatore può leggerla o scriverla
+bool isPromotableAlloca(const Value *Object) {
+    auto *AI = dyn_cast<AllocaInst>(Object);
+    if (!AI || AI->isArrayAllocation()) {
+        return false;
+    }
+    for (const User *U : AI->users()) {
+        if (auto *Load = dyn_cast<LoadInst>(U)) {
+            if (!Load->isSimple()) {
+                return false;
+            }
+            continue;
+        }
+        if (auto *Store = dyn_cast<StoreInst>(U)) {
+            if (!Store->isSimple() || Store->getValueOperand() == AI) {
+                return false;
             }
+            continue;
         }
+        return false;
     }
-    errs() << "[DEBUG] Nessuna riscrittura trovata per " << I << "\n";
-    return false;
+    return true;
+}
+
+// Sostituisce gli store a una variabile riassegnata nel loop (es. e = 7 /
+// e = 8) con valori SSA: dentro il loop le load leggono il valore corrente,
+// e in ogni uscita un solo store scrive la PHI che unisce i valori finali.
+bool sinkInvariantStores(Loop *L, const SmallVectorImpl<BasicBlock *> &ExitBlocks, MemorySSAUpdater *MSSAU) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (ExitBlocks.empty() || !L->hasDedicatedExits()) {
+        return false;
+    }
+
+    bool Changed = false;
+    for (auto &Entry : StoreIndex) {
+        if (!isPromotableAlloca(Entry.first)) {
+            continue;
+        }
+        auto *AI = const_cast<AllocaInst *>(cast<AllocaInst>(Entry.first));
+        Type *Ty = Entry.second.front()->getValueOperand()->getType();
+
+        // Tutti gli accessi nel loop devono usare lo stesso tipo
+        SmallVector<LoadInst *, 4> Loads;
+        bool SameType = true;
+        for (User *U : AI->users()) {
+            auto *Inst = cast<Instruction>(U);
+            if (!L->contains(Inst->getParent())) {
+                continue;
+            }
+            if (auto *Load = dyn_cast<LoadInst>(Inst)) {
+                SameType &= Load->getType() == Ty;
+                Loads.push_back(Load);
+            } else {
+                SameType &= cast<StoreInst>(Inst)->getValueOperand()->getType() == Ty;
+            }
+        }
+        if (!SameType) {
+            errs() << "[DEBUG] Accessi di tipo diverso a " << *AI << ", niente sinking.\n";
+            continue;
+        }
+
+        errs() << "Sinking stores to " << AI->getName() << " out of the loop.\n";
+
+        SmallVector<Instruction *, 8> LoopUses(Loads.begin(), Loads.end());
+        LoopUses.append(Entry.second.begin(), Entry.second.end());
+
+        // Valore della variabile all'ingresso del loop
+        auto *Promoted = new LoadInst(Ty, AI, AI->getName() + ".promoted", Preheader->getTerminator());
+        Promoted->setAlignment(AI->getAlign());
+        if (MSSAU) {
+            MemoryAccess *MA = MSSAU->createMemoryAccessInBB(Promoted, nullptr, Preheader, MemorySSA::BeforeTerminator);
+            MSSAU->insertUse(cast<MemoryUse>(MA), /*RenameUses=*/true);
+        }
+
+        SmallVector<PHINode *, 8> NewPHIs;
+        SSAUpdater SSA(&NewPHIs);
+        StorePromoter Promoter(LoopUses, SSA, L, AI, ExitBlocks, MSSAU);
+        SSA.AddAvailableValue(Preheader, Promoted);
+        Promoter.run(LoopUses);
+
+        Changed = true;
+    }
+
+    StoreIndex.clear();
+    return Changed;
 }
 
 bool dominatesAllUses(Instruction &I, Loop *L, DominatorTree &DT) {
@@ -183,11 +525,6 @@ bool allDependenciesMoved(Instruction &I, const std::set<Instruction *> &MovedIn
                 return false;
         }
 
-        if (isReassignedInLoop(I, L)) {
-                errs() << "Istruzione riscritta nel loop: " << I << "\n";
-                return false;   
-        }
-
         if (!dominatesAllUses(I, L, DT)) {
                 errs() << "Istruzione " << I << " non domina tutti gli usi nel loop.\n";
                 return false;
@@ -207,6 +544,30 @@ bool allDependenciesMoved(Instruction &I, const std::set<Instruction *> &MovedIn
 
 };
 
+// Stessa trasformazione come loop pass, per poterla inserire in un
+// LoopPassManager (es. -passes='loop-mssa(local-opts)'). Il LoopPassManager
+// garantisce preheader e forma LCSSA e visita anche i loop annidati.
+struct TestLoopPass : PassInfoMixin<TestLoopPass> {
+  PreservedAnalyses run(Loop &L, LoopAnalysisManager &, LoopStandardAnalysisResults &AR, LPMUpdater &) {
+    std::unique_ptr<MemorySSAUpdater> MSSAU;
+    if (AR.MSSA) {
+        MSSAU = std::make_unique<MemorySSAUpdater>(AR.MSSA);
+    }
+
+    if (!TestPass().runOnLoop(&L, AR.DT, MSSAU.get())) {
+        return PreservedAnalyses::all();
+    }
+
+    PreservedAnalyses PA = getLoopPassPreservedAnalyses();
+    if (AR.MSSA) {
+        PA.preserve<MemorySSAAnalysis>();
+    }
+    return PA;
+  }
+
+  static bool isRequired() { return true; }
+};
+
 
 //-----------------------------------------------------------------------------
 // New PM Registration
@@ -223,6 +584,15 @@ llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
                   }
                   return false;
                 });
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, LoopPassManager &LPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "local-opts") {
+                    LPM.addPass(TestLoopPass());
+                    return true;
+                  }
+                  return false;
+                });
           }};
 }
 
@@ -0,0 +1,79 @@
+#include <stdio.h>
+
+// Come test.c, ma il loop termina. Dopo mem2reg f = y + 1 arriva all'uscita
+// attraverso la PHI dell'header, che è un suo utente nel loop: qui non c'è
+// niente da affondare
+int test_sinking(int n) {
+    int a = 0, f = 0, y = 0;
+
+    for (int i = 0; i < n; i++) {
+        y = a + i;
+        f = y + 1; // usata solo fuori dal loop
+        a++;
+    }
+
+    return f;
+}
+
+// Il test di uscita viene dopo il calcolo di f: f non passa da una PHI
+// dell'header e il suo unico uso è dopo il loop, quindi f = y + 1 (e y)
+// vengono calcolate una sola volta nel blocco di uscita
+int test_sinking_after_loop(int n) {
+    int a = 0, i = 0, f;
+
+    while (1) {
+        int y = a + i;
+        f = y + 1; // usata solo fuori dal loop
+        if (i >= n)
+            break;
+        a += 2;
+        i++;
+    }
+
+    return f;
+}
+
+// Due uscite che usano entrambe g: ne viene creata una copia per ogni
+// uscita, con gli operandi presi dalle PHI LCSSA
+int test_sinking_multi_exit(int n, int m) {
+    int i = 0, g;
+
+    while (1) {
+        g = i * 3 + 1; // usata solo fuori dal loop, in due uscite diverse
+        if (i == m)
+            return g * 2;
+        if (i >= n)
+            break;
+        i++;
+    }
+
+    return g;
+}
+
+// e = 7 / e = 8 come in test.c, ma in un loop che termina: gli store a
+// indirizzo invariante diventano un solo store del valore finale all'uscita.
+// Lo sinking degli store lavora sulle alloca, quindi questo caso si vede
+// solo sull'IR -O0 senza mem2reg (come test.ll), cioè clang -O0 -Xclang
+// -disable-O0-optnone seguito direttamente dal pass; dopo mem2reg e e
+// count sono già registri e non resta nessuno store da spostare
+int test_store_sinking(int n) {
+    int e = 0, count = 0;
+
+    for (int a = 0; a < n; a++) {
+        e = 7;
+        if (a % 2 == 0)
+            e = 8;
+        count++;
+    }
+
+    return e + count;
+}
+
+int main() {
+    printf("%d\n", test_sinking(10));
+    printf("%d\n", test_sinking_after_loop(10));
+    printf("%d\n", test_sinking_multi_exit(10, 4));
+    printf("%d\n", test_sinking_multi_exit(10, 20));
+    printf("%d\n", test_store_sinking(10));
+    return 0;
+}
@@ -0,0 +1,447 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include <map>
+#include <tuple>
+#include <vector>
+
+using namespace llvm;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Lazy Code Motion (Knoop, Rüthing, Steffen) nella formulazione del Dragon
+// Book: quattro analisi dataflow (anticipated, available, postponable, used)
+// decidono dove inserire ogni espressione, il più tardi possibile, così da
+// eliminare le ridondanze parziali senza allungare i live range.
+namespace {
+
+// Un'espressione è identificata da opcode, tipo e operandi
+using ExprKey = std::tuple<unsigned, Type *, Value *, Value *>;
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Espressioni candidate, indicizzate nell'ordine in cui compaiono
+  std::map<ExprKey, unsigned> ExprIds;
+  std::vector<std::vector<BinaryOperator *>> Occurrences;
+
+  // Insiemi locali di ogni blocco
+  DenseMap<BasicBlock *, BitVector> EUse, EKill;
+
+  // Risultati delle analisi
+  DenseMap<BasicBlock *, BitVector> AntIn, AntOut, AvIn, AvOut;
+  DenseMap<BasicBlock *, BitVector> Earliest, PostIn, PostOut, Latest;
+  DenseMap<BasicBlock *, BitVector> UsedIn, UsedOut;
+
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &) {
+    if (F.isDeclaration() || !hasSplittableEdges(F))
+      return PreservedAnalyses::all();
+
+    // L'inserimento avviene all'inizio dei blocchi: gli archi critici vanno
+    // spezzati per avere un punto in cui calcolare l'espressione su un solo arco
+    bool Changed = SplitAllCriticalEdges(F) > 0;
+
+    ReversePostOrderTraversal<Function *> RPOT(&F);
+    std::vector<BasicBlock *> Order(RPOT.begin(), RPOT.end());
+
+    collectExpressions(Order);
+    if (Occurrences.empty()) {
+      clear();
+      return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+    computeLocalSets(Order);
+    computeAnticipated(Order);
+    computeAvailable(Order);
+    computeEarliest(Order);
+    computePostponable(Order);
+    computeLatest(Order);
+    computeUsed(Order);
+
+    Changed |= transform(Order);
+    clear();
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+  }
+
+  void clear() {
+    ExprIds.clear();
+    Occurrences.clear();
+    for (auto *M : {&EUse, &EKill, &AntIn, &AntOut, &AvIn, &AvOut, &Earliest,
+                    &PostIn, &PostOut, &Latest, &UsedIn, &UsedOut})
+      M->clear();
+  }
+
+  // Gli archi uscenti da invoke, callbr o indirectbr non si possono spezzare
+  bool hasSplittableEdges(Function &F) {
+    for (BasicBlock &BB : F) {
+      if (BB.isEHPad())
+        return false;
+      Instruction *Term = BB.getTerminator();
+      if (isa<InvokeInst>(Term) || isa<CallBrInst>(Term) ||
+          isa<IndirectBrInst>(Term))
+        return false;
+    }
+    return true;
+  }
+
+  // Solo operazioni binarie che possono essere calcolate in anticipo senza
+  // rischi (niente divisioni per valori non costanti)
+  bool isCandidateExpression(Instruction &I) {
+    auto *BinOp = dyn_cast<BinaryOperator>(&I);
+    if (!BinOp)
+      return false;
+    return isSafeToSpeculativelyExecute(BinOp);
+  }
+
+  ExprKey getKey(BinaryOperator *BinOp) {
+    Value *LHS = BinOp->getOperand(0);
+    Value *RHS = BinOp->getOperand(1);
+    // Per gli operatori commutativi a+b e b+a sono la stessa espressione
+    if (BinOp->isCommutative() && std::less<Value *>()(RHS, LHS))
+      std::swap(LHS, RHS);
+    return ExprKey(BinOp->getOpcode(), BinOp->getType(), LHS, RHS);
+  }
+
+  void collectExpressions(const std::vector<BasicBlock *> &Order) {
+    for (BasicBlock *BB : Order) {
+      for (Instruction &I : *BB) {
+        if (!isCandidateExpression(I))
+          continue;
+        auto *BinOp = cast<BinaryOperator>(&I);
+        auto It = ExprIds.try_emplace(getKey(BinOp), Occurrences.size());
+        if (It.second)
+          Occurrences.emplace_back();
+        Occurrences[It.first->second].push_back(BinOp);
+      }
+    }
+    errs() << "[DEBUG] Trovate " << Occurrences.size()
+           << " espressioni candidate.\n";
+  }
+
+  // Un'espressione è "uccisa" in un blocco se uno dei suoi operandi vi è
+  // definito (PHI compresi). In SSA un calcolo che non usa valori definiti nel
+  // blocco stesso è sempre esposto verso l'alto.
+  void computeLocalSets(const std::vector<BasicBlock *> &Order) {
+    unsigned N = Occurrences.size();
+    for (BasicBlock *BB : Order) {
+      EUse[BB] = BitVector(N);
+      EKill[BB] = BitVector(N);
+    }
+
+    for (unsigned E = 0; E < N; ++E) {
+      BinaryOperator *First = Occurrences[E].front();
+      for (Value *Op : First->operands())
+        if (auto *OpInst = dyn_cast<Instruction>(Op))
+          if (EKill.count(OpInst->getParent()))
+            EKill[OpInst->getParent()].set(E);
+
+      for (BinaryOperator *Occ : Occurrences[E])
+        if (!EKill[Occ->getParent()].test(E))
+          EUse[Occ->getParent()].set(E);
+    }
+  }
+
+  // Anticipated: analisi all'indietro, meet = intersezione
+  void computeAnticipated(const std::vector<BasicBlock *> &Order) {
+    unsigned N = Occurrences.size();
+    for (BasicBlock *BB : Order) {
+      AntIn[BB] = BitVector(N, true);
+      AntOut[BB] = BitVector(N);
+    }
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (auto It = Order.rbegin(); It != Order.rend(); ++It) {
+        BasicBlock *BB = *It;
+        BitVector Out = meetSuccessors(BB, AntIn, /*Intersect=*/true);
+        BitVector In = Out;
+        In.reset(EKill[BB]);
+        In |= EUse[BB];
+        AntOut[BB] = Out;
+        if (In != AntIn[BB]) {
+          AntIn[BB] = In;
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  // Available (supponendo di inserire dove anticipated): analisi in avanti,
+  // meet = intersezione
+  void computeAvailable(const std::vector<BasicBlock *> &Order) {
+    unsigned N = Occurrences.size();
+    for (BasicBlock *BB : Order) {
+      AvIn[BB] = BitVector(N);
+      AvOut[BB] = BitVector(N, true);
+    }
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock *BB : Order) {
+        BitVector In = meetPredecessors(BB, AvOut, /*Intersect=*/true);
+        BitVector Out = AntIn[BB];
+        Out |= In;
+        Out.reset(EKill[BB]);
+        AvIn[BB] = In;
+        if (Out != AvOut[BB]) {
+          AvOut[BB] = Out;
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  // Earliest = anticipated.in - available.in
+  void computeEarliest(const std::vector<BasicBlock *> &Order) {
+    for (BasicBlock *BB : Order) {
+      BitVector E = AntIn[BB];
+      E.reset(AvIn[BB]);
+      Earliest[BB] = E;
+    }
+  }
+
+  // Postponable: analisi in avanti, meet = intersezione
+  void computePostponable(const std::vector<BasicBlock *> &Order) {
+    unsigned N = Occurrences.size();
+    for (BasicBlock *BB : Order) {
+      PostIn[BB] = BitVector(N);
+      PostOut[BB] = BitVector(N, true);
+    }
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (BasicBlock *BB : Order) {
+        BitVector In = meetPredecessors(BB, PostOut, /*Intersect=*/true);
+        BitVector Out = Earliest[BB];
+        Out |= In;
+        Out.reset(EUse[BB]);
+        PostIn[BB] = In;
+        if (Out != PostOut[BB]) {
+          PostOut[BB] = Out;
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  // Latest = (earliest ∪ postponable.in) ∩
+  //          (e_use ∪ ¬(∩ successori (earliest ∪ postponable.in)))
+  void computeLatest(const std::vector<BasicBlock *> &Order) {
+    unsigned N = Occurrences.size();
+    for (BasicBlock *BB : Order) {
+      BitVector Candidate = Earliest[BB];
+      Candidate |= PostIn[BB];
+
+      BitVector AllSuccs(N, true);
+      bool HasSucc = false;
+      for (BasicBlock *Succ : successors(BB)) {
+        if (!Earliest.count(Succ))
+          continue;
+        BitVector S = Earliest[Succ];
+        S |= PostIn[Succ];
+        AllSuccs &= S;
+        HasSucc = true;
+      }
+      if (!HasSucc)
+        AllSuccs.reset();
+
+      BitVector Cond = AllSuccs;
+      Cond.flip();
+      Cond |= EUse[BB];
+
+      Candidate &= Cond;
+      Latest[BB] = Candidate;
+    }
+  }
+
+  // Used: analisi all'indietro, meet = unione
+  void computeUsed(const std::vector<BasicBlock *> &Order) {
+    unsigned N = Occurrences.size();
+    for (BasicBlock *BB : Order) {
+      UsedIn[BB] = BitVector(N);
+      UsedOut[BB] = BitVector(N);
+    }
+
+    bool Changed = true;
+    while (Changed) {
+      Changed = false;
+      for (auto It = Order.rbegin(); It != Order.rend(); ++It) {
+        BasicBlock *BB = *It;
+        BitVector Out = meetSuccessors(BB, UsedIn, /*Intersect=*/false);
+        BitVector In = EUse[BB];
+        In |= Out;
+        In.reset(Latest[BB]);
+        UsedOut[BB] = Out;
+        if (In != UsedIn[BB]) {
+          UsedIn[BB] = In;
+          Changed = true;
+        }
+      }
+    }
+  }
+
+  BitVector meetSuccessors(BasicBlock *BB,
+                           DenseMap<BasicBlock *, BitVector> &Sets,
+                           bool Intersect) {
+    BitVector Result(Occurrences.size(), Intersect);
+    bool Any = false;
+    for (BasicBlock *Succ : successors(BB)) {
+      auto It = Sets.find(Succ);
+      if (It == Sets.end())
+        continue;
+      if (Intersect)
+        Result &= It->second;
+      else
+        Result |= It->second;
+      Any = true;
+    }
+    // Il blocco di uscita ha l'insieme vuoto come condizione al contorno
+    if (!Any)
+      Result.reset();
+    return Result;
+  }
+
+  BitVector meetPredecessors(BasicBlock *BB,
+                             DenseMap<BasicBlock *, BitVector> &Sets,
+                             bool Intersect) {
+    BitVector Result(Occurrences.size(), Intersect);
+    bool Any = false;
+    for (BasicBlock *Pred : predecessors(BB)) {
+      auto It = Sets.find(Pred);
+      if (It == Sets.end())
+        continue;
+      if (Intersect)
+        Result &= It->second;
+      else
+        Result |= It->second;
+      Any = true;
+    }
+    // Il blocco di entry ha l'insieme vuoto come condizione al contorno
+    if (!Any)
+      Result.reset();
+    return Result;
+  }
+
+  // Inserisce t = x op y nei blocchi latest ∩ used.out e sostituisce con t i
+  // calcoli originali nei blocchi e_use ∩ (¬latest ∪ used.out)
+  bool transform(const std::vector<BasicBlock *> &Order) {
+    bool Changed = false;
+
+    for (unsigned E = 0; E < Occurrences.size(); ++E) {
+      BinaryOperator *First = Occurrences[E].front();
+
+      DenseMap<BasicBlock *, BinaryOperator *> Inserted;
+      std::vector<BinaryOperator *> ToReplace;
+
+      for (BasicBlock *BB : Order) {
+        if (Latest[BB].test(E) && UsedOut[BB].test(E)) {
+          auto *T = cast<BinaryOperator>(First->clone());
+          T->setName(First->getName() + ".lcm");
+          T->setDebugLoc(DebugLoc());
+          T->insertBefore(&*BB->getFirstInsertionPt());
+          Inserted[BB] = T;
+          errs() << "[DEBUG] Inserita " << *T << " in " << BB->getName()
+                 << "\n";
+        }
+      }
+
+      for (BinaryOperator *Occ : Occurrences[E]) {
+        BasicBlock *BB = Occ->getParent();
+        if (!EUse[BB].test(E))
+          continue;
+        if (Latest[BB].test(E) && !UsedOut[BB].test(E))
+          continue;
+        ToReplace.push_back(Occ);
+      }
+
+      // I calcoli lasciati al loro posto rendono ridondanti quelli successivi
+      // nello stesso blocco
+      DenseMap<BasicBlock *, BinaryOperator *> Kept;
+      for (BinaryOperator *Occ : Occurrences[E]) {
+        BasicBlock *BB = Occ->getParent();
+        if (!EUse[BB].test(E) || !Latest[BB].test(E) || UsedOut[BB].test(E))
+          continue;
+        auto It = Kept.try_emplace(BB, Occ);
+        if (It.second)
+          continue;
+        It.first->second->andIRFlags(Occ);
+        errs() << "[DEBUG] Calcolo localmente ridondante: " << *Occ << "\n";
+        Occ->replaceAllUsesWith(It.first->second);
+        Occ->eraseFromParent();
+        Changed = true;
+      }
+
+      if (ToReplace.empty())
+        continue;
+
+      // t sostituisce più calcoli: i flag nsw/nuw/exact valgono solo se
+      // presenti su tutti
+      for (auto &Entry : Inserted)
+        for (BinaryOperator *Occ : ToReplace)
+          Entry.second->andIRFlags(Occ);
+
+      SSAUpdater SSA;
+      SSA.Initialize(First->getType(), First->getName().str() + ".lcm");
+      for (auto &Entry : Inserted)
+        SSA.AddAvailableValue(Entry.first, Entry.second);
+
+      for (BinaryOperator *Occ : ToReplace) {
+        BasicBlock *BB = Occ->getParent();
+        auto It = Inserted.find(BB);
+        Value *T = It != Inserted.end() ? It->second
+                                        : SSA.GetValueInMiddleOfBlock(BB);
+        errs() << "[DEBUG] Sostituisco " << *Occ << " con " << *T << "\n";
+        Occ->replaceAllUsesWith(T);
+        Occ->eraseFromParent();
+      }
+      Changed = true;
+    }
+
+    return Changed;
+  }
+
+  // Questo pass è richiesto per le funzioni con l'attributo optnone
+  static bool isRequired() { return true; }
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "lazyCodeMotion", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "lazy-code-motion") {
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
@@ -0,0 +1,33 @@
+#include <stdio.h>
+
+// Ridondanza parziale su un diamante if/else: a + b è calcolata solo nel
+// ramo then, ma serve anche dopo il join
+int test_diamond(int a, int b, int c) {
+    int x = 0;
+    if (c > 0)
+        x = a + b;
+    else
+        x = c;
+
+    int y = a + b; // parzialmente ridondante
+    return x + y;
+}
+
+// Ridondanza lungo il cammino del loop: a * b viene ricalcolata ad ogni
+// iterazione e di nuovo all'uscita
+int test_loop(int a, int b, int n) {
+    int s = 0;
+    int i = 0;
+    do {
+        s += a * b; // loop-invariant, anticipata nel preheader
+        i++;
+    } while (i < n);
+
+    return s + a * b; // completamente ridondante
+}
+
+int main() {
+    printf("%d\n", test_diamond(3, 4, 1));
+    printf("%d\n", test_loop(3, 4, 5));
+    return 0;
+}
@@ -0,0 +1,365 @@
+#ifndef ASSIGNMENT4_LOOP_NEST_H
+#define ASSIGNMENT4_LOOP_NEST_H
+
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include <algorithm>
+#include <set>
+
+//-----------------------------------------------------------------------------
+// Loop non ruotati e nest perfetti di loop
+//-----------------------------------------------------------------------------
+// Funzioni comuni ai pass di questo assignment: forma dei loop con l'uscita
+// nell'header e loro variabile di induzione, e per i pass che riordinano i
+// loop di un nest (loop interchange e loop tiling) riconoscimento del nest
+// perfetto, controllo di ogni livello e direzioni delle dipendenze tra gli
+// accessi del loop più interno.
+namespace loop_nest {
+
+using namespace llvm;
+
+static const unsigned MaxNestDepth = 3;
+// Oltre questo numero di vettori di distanza la ricerca esatta lascia il
+// posto alle direzioni di DependenceInfo
+static const uint64_t MaxDistanceVectors = 1 << 16;
+
+// Variabile di induzione di un livello del nest, con il suo incremento nel
+// latch, il confronto che decide l'uscita nell'header e il passo (0 se non
+// è costante)
+struct LoopControl {
+    PHINode *IV;
+    Instruction *Next;
+    ICmpInst *Cmp;
+    int64_t Step;
+};
+
+// Forma dei loop non ruotati su cui lavorano questi pass: preheader, un solo
+// latch e una sola uscita, decisa dall'header, il cui primo successore è il
+// body. Pass dà il nome della trasformazione nei messaggi.
+inline bool isHeaderExitingLoop(Loop *L, raw_ostream &OS, StringRef Pass) {
+    if (!L->getLoopPreheader() || !L->getLoopLatch() || !L->getExitingBlock() || !L->getExitBlock()) {
+        OS << "Loop is not a candidate for " << Pass << "\n";
+        return false;
+    }
+    if (!L->isLoopSimplifyForm()) {
+        OS << "Loop is not in a simplified form\n";
+        return false;
+    }
+    auto *BI = dyn_cast<BranchInst>(L->getHeader()->getTerminator());
+    if (L->getExitingBlock() != L->getHeader() || !BI || !BI->isConditional() ||
+        !L->contains(BI->getSuccessor(0))) {
+        OS << "Loop header is not the only exiting block\n";
+        return false;
+    }
+    return true;
+}
+
+// Variabile di induzione che controlla l'uscita di L. Loop::getInductionVariable
+// cerca il confronto nel latch: nei loop non ruotati è nell'header
+inline PHINode *getInductionVariable(Loop *L, ScalarEvolution &SE) {
+    if (PHINode *IV = L->getInductionVariable(SE))
+        return IV;
+
+    auto *BI = dyn_cast<BranchInst>(L->getHeader()->getTerminator());
+    auto *Cmp = BI && BI->isConditional() ? dyn_cast<ICmpInst>(BI->getCondition()) : nullptr;
+    if (!Cmp)
+        return nullptr;
+    for (Value *Op : Cmp->operands()) {
+        auto *PN = dyn_cast<PHINode>(Op);
+        InductionDescriptor ID;
+        if (PN && PN->getParent() == L->getHeader() &&
+            InductionDescriptor::isInductionPHI(PN, L, &SE, ID))
+            return PN;
+    }
+    return nullptr;
+}
+
+// L'header contiene solo la variabile di induzione e il confronto, il latch
+// solo l'incremento, e inizio e limite non dipendono dal nest (spazio di
+// iterazione rettangolare): il controllo di L può essere spostato o
+// modificato senza toccare il body
+inline bool getLoopControl(Loop *L, Loop *Root, ScalarEvolution &SE, LoopControl &Control) {
+    PHINode *IV = getInductionVariable(L, SE);
+    if (!IV) {
+        errs() << "Induction variable not found\n";
+        return false;
+    }
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    auto *BI = cast<BranchInst>(Header->getTerminator());
+    auto *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+    auto *Next = dyn_cast<Instruction>(IV->getIncomingValueForBlock(Latch));
+    if (!Cmp || Cmp->getParent() != Header || !Cmp->hasOneUse() || !Next || Next->getParent() != Latch) {
+        errs() << "Loop control is not in the header and latch\n";
+        return false;
+    }
+    if (Header->size() != 3 || Latch->size() != 2) {
+        errs() << "Loop header or latch contains more than the loop control\n";
+        return false;
+    }
+    if (!Root->isLoopInvariant(IV->getIncomingValueForBlock(L->getLoopPreheader())) ||
+        !Root->isLoopInvariant(Cmp->getOperand(Cmp->getOperand(0) == IV ? 1 : 0))) {
+        errs() << "Loop bounds depend on the nest\n";
+        return false;
+    }
+    // Il valore finale cambierebbe con l'ordine dei loop
+    for (User *U : IV->users()) {
+        if (!Root->contains(cast<Instruction>(U))) {
+            errs() << "Induction variable is used after the nest\n";
+            return false;
+        }
+    }
+    InductionDescriptor ID;
+    InductionDescriptor::isInductionPHI(IV, L, &SE, ID);
+    ConstantInt *Step = ID.getConstIntStepValue();
+    Control = {IV, Next, Cmp, Step ? Step->getSExtValue() : 0};
+    return true;
+}
+
+// Raccoglie il nest perfetto che parte da Root: ogni loop ha un solo figlio,
+// il suo body è il preheader del figlio e l'uscita del figlio porta
+// direttamente al suo latch. Solo il loop più interno ha istruzioni.
+inline bool collectPerfectNest(Loop *Root, ScalarEvolution &SE, StringRef Pass, SmallVectorImpl<Loop *> &Nest,
+                               SmallVectorImpl<LoopControl> &Controls) {
+    Loop *L = Root;
+    while (true) {
+        if (!isHeaderExitingLoop(L, errs(), Pass))
+            return false;
+        Nest.push_back(L);
+        if (L->isInnermost())
+            break;
+        if (L->getSubLoops().size() != 1 || Nest.size() == MaxNestDepth) {
+            errs() << "Loop nest is not a perfect 2- or 3-deep nest\n";
+            return false;
+        }
+
+        Loop *Inner = L->getSubLoops().front();
+        BasicBlock *Body = L->getHeader()->getTerminator()->getSuccessor(0);
+        BasicBlock *InnerExit = Inner->getExitBlock();
+        if (Body != Inner->getLoopPreheader() || Body->size() != 1 || !InnerExit ||
+            InnerExit->size() != 1 || InnerExit->getSingleSuccessor() != L->getLoopLatch()) {
+            errs() << "Loop nest is not perfect\n";
+            return false;
+        }
+        L = Inner;
+    }
+    if (Nest.size() < 2)
+        return false;
+
+    for (Loop *NL : Nest) {
+        Controls.emplace_back();
+        if (!getLoopControl(NL, Root, SE, Controls.back()))
+            return false;
+    }
+    return true;
+}
+
+// Indirizzo dell'accesso come Base + somma di Steps[k] * I_k, con I_k il
+// numero di iterazione del livello k del nest e passi costanti
+inline bool getAccessFunction(Instruction *I, ArrayRef<Loop *> Nest, ScalarEvolution &SE,
+                              const SCEV *&Base, SmallVectorImpl<int64_t> &Steps) {
+    Steps.assign(Nest.size(), 0);
+    const SCEV *S = SE.getSCEV(getLoadStorePointerOperand(I));
+    while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+        auto It = std::find(Nest.begin(), Nest.end(), AR->getLoop());
+        auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        if (It == Nest.end() || !AR->isAffine() || !Step)
+            return false;
+        Steps[It - Nest.begin()] = Step->getAPInt().getSExtValue();
+        S = AR->getStart();
+    }
+    Base = S;
+    return true;
+}
+
+// Direzione di un vettore di distanza orientato dall'iterazione che esegue
+// prima. Delta nullo (stessa iterazione) non dà una dipendenza tra
+// iterazioni: l'ordine resta quello del body.
+inline void addDistanceDirection(ArrayRef<int64_t> Delta, std::set<SmallVector<unsigned, 3>> &Patterns) {
+    auto First = std::find_if(Delta.begin(), Delta.end(), [](int64_t D) { return D != 0; });
+    if (First == Delta.end())
+        return;
+    int Sign = *First > 0 ? 1 : -1;
+    SmallVector<unsigned, 3> Dir;
+    for (int64_t D : Delta) {
+        D *= Sign;
+        Dir.push_back(D > 0 ? Dependence::DVEntry::LT
+                            : D < 0 ? Dependence::DVEntry::GT : Dependence::DVEntry::EQ);
+    }
+    Patterns.insert(Dir);
+}
+
+// Nei loop non ruotati la variabile di induzione dell'header raggiunge il
+// limite, e DependenceInfo non riesce a dimostrare che gli indici restano
+// nelle dimensioni dell'array: le direzioni diventano '*'. Con passi
+// costanti e numero massimo di iterazioni noto si possono invece trovare i
+// vettori di distanza Delta = J - I per cui i due accessi si sovrappongono.
+// Le direzioni dipendono solo dai segni di Delta: si elencano i valori di
+// tutti i livelli tranne uno, e su quello (Solved) la sovrapposizione
+// diventa un intervallo di valori di cui bastano i segni.
+inline bool getExactDirections(Instruction *Src, Instruction *Dst, ArrayRef<Loop *> Nest,
+                               ScalarEvolution &SE, SmallVectorImpl<SmallVector<unsigned, 3>> &Directions) {
+    const SCEV *SrcBase, *DstBase;
+    SmallVector<int64_t, 3> Steps, DstSteps;
+    if (!getAccessFunction(Src, Nest, SE, SrcBase, Steps) ||
+        !getAccessFunction(Dst, Nest, SE, DstBase, DstSteps) || Steps != DstSteps)
+        return false;
+    auto *Diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(DstBase, SrcBase));
+    if (!Diff)
+        return false;
+
+    // Valori di Delta possibili per ogni livello: con passo nullo il livello
+    // non cambia l'indirizzo e bastano i tre segni
+    SmallVector<int64_t, 3> Max;
+    int Solved = -1;
+    for (unsigned k = 0; k < Nest.size(); ++k) {
+        auto *BTC = dyn_cast<SCEVConstant>(SE.getConstantMaxBackedgeTakenCount(Nest[k]));
+        if (!BTC)
+            return false;
+        // L'uscita è nell'header: il body esegue BTC volte, con I_k in [0, BTC - 1]
+        int64_t M = std::max<int64_t>(BTC->getAPInt().getSExtValue() - 1, 0);
+        if (Steps[k] == 0)
+            M = std::min<int64_t>(M, 1);
+        else if (Solved < 0 || M > Max[Solved])
+            Solved = k;
+        Max.push_back(M);
+    }
+    uint64_t Count = 1;
+    for (unsigned k = 0; k < Nest.size(); ++k) {
+        if (int(k) == Solved)
+            continue;
+        Count *= 2 * Max[k] + 1;
+        if (Count > MaxDistanceVectors)
+            return false;
+    }
+
+    const DataLayout &DL = Src->getModule()->getDataLayout();
+    int64_t SrcSize = DL.getTypeStoreSize(getLoadStoreType(Src)).getFixedValue();
+    int64_t DstSize = DL.getTypeStoreSize(getLoadStoreType(Dst)).getFixedValue();
+    int64_t Offset = Diff->getAPInt().getSExtValue();
+    auto FloorDiv = [](int64_t A, int64_t B) { return A / B - ((A % B != 0) && ((A < 0) != (B < 0))); };
+
+    std::set<SmallVector<unsigned, 3>> Patterns;
+    SmallVector<int64_t, 3> Delta(Nest.size());
+    for (unsigned k = 0; k < Nest.size(); ++k)
+        Delta[k] = int(k) == Solved ? 0 : -Max[k];
+    while (true) {
+        // I byte si sovrappongono se Offset + Steps * Delta cade in
+        // (-DstSize, SrcSize)
+        int64_t Distance = Offset;
+        for (unsigned k = 0; k < Nest.size(); ++k)
+            if (int(k) != Solved)
+                Distance += Steps[k] * Delta[k];
+        if (Solved < 0) {
+            if (Distance > -DstSize && Distance < SrcSize)
+                addDistanceDirection(Delta, Patterns);
+        } else {
+            // Steps[Solved] * D in (-DstSize - Distance, SrcSize - Distance):
+            // con S = |Steps[Solved]|, S * E cade nell'intervallo per E in
+            // [Lo, Hi], e D = E o D = -E a seconda del segno del passo
+            int64_t S = std::abs(Steps[Solved]);
+            int64_t Lo = FloorDiv(-DstSize - Distance, S) + 1;
+            int64_t Hi = -FloorDiv(-(SrcSize - Distance), S) - 1;
+            if (Steps[Solved] < 0) {
+                std::swap(Lo, Hi);
+                Lo = -Lo;
+                Hi = -Hi;
+            }
+            Lo = std::max(Lo, -Max[Solved]);
+            Hi = std::min(Hi, Max[Solved]);
+            // Un valore per ogni segno presente nell'intervallo
+            for (int64_t D : {Lo, int64_t(0), Hi}) {
+                if (D < Lo || D > Hi)
+                    continue;
+                Delta[Solved] = D;
+                addDistanceDirection(Delta, Patterns);
+            }
+            Delta[Solved] = 0;
+        }
+
+        unsigned k = 0;
+        while (k < Nest.size() && (int(k) == Solved || Delta[k] == Max[k])) {
+            if (int(k) != Solved)
+                Delta[k] = -Max[k];
+            ++k;
+        }
+        if (k == Nest.size())
+            break;
+        ++Delta[k];
+    }
+    Directions.append(Patterns.begin(), Patterns.end());
+    return true;
+}
+
+// Accessi in memoria del loop più interno e direzioni delle dipendenze tra
+// di essi, orientate dall'iterazione che esegue prima. Restituisce false se
+// qualche dipendenza non è analizzabile.
+inline bool collectDirections(ArrayRef<Loop *> Nest, DependenceInfo &DI, ScalarEvolution &SE,
+                              SmallVectorImpl<SmallVector<unsigned, 3>> &Directions) {
+    SmallVector<Instruction *, 16> Accesses;
+    for (BasicBlock *BB : Nest.back()->blocks()) {
+        for (Instruction &I : *BB) {
+            if (!I.mayReadOrWriteMemory())
+                continue;
+            if (!isa<LoadInst>(I) && !isa<StoreInst>(I)) {
+                errs() << "Loop nest accesses memory through a call\n";
+                return false;
+            }
+            Accesses.push_back(&I);
+        }
+    }
+
+    // I livelli di Dependence partono dal loop più esterno della funzione
+    unsigned First = Nest.front()->getLoopDepth();
+    for (unsigned i = 0; i < Accesses.size(); ++i) {
+        for (unsigned j = i; j < Accesses.size(); ++j) {
+            if (!Accesses[i]->mayWriteToMemory() && !Accesses[j]->mayWriteToMemory())
+                continue;
+            auto D = DI.depends(Accesses[i], Accesses[j], true);
+            if (!D)
+                continue;
+            if (getExactDirections(Accesses[i], Accesses[j], Nest, SE, Directions))
+                continue;
+            if (D->isConfused() || D->getLevels() < First + Nest.size() - 1) {
+                errs() << "Dependence is not analyzable\n";
+                return false;
+            }
+            // Le dipendenze portate da un loop che contiene il nest non
+            // dipendono dall'ordine dei suoi loop
+            bool OuterCarried = false;
+            for (unsigned Level = 1; Level < First; ++Level)
+                if (!(D->getDirection(Level) & Dependence::DVEntry::EQ))
+                    OuterCarried = true;
+            if (OuterCarried)
+                continue;
+
+            SmallVector<unsigned, 3> Dir;
+            for (unsigned Level = 0; Level < Nest.size(); ++Level)
+                Dir.push_back(D->getDirection(First + Level));
+            // DependenceInfo segue l'ordine delle istruzioni nel body: se il
+            // primo livello diverso da '=' è '>' la dipendenza va dalla
+            // seconda istruzione alla prima, e il vettore si rovescia
+            auto Lead = std::find_if(Dir.begin(), Dir.end(),
+                                     [](unsigned D) { return D != Dependence::DVEntry::EQ; });
+            if (Lead != Dir.end() && *Lead == Dependence::DVEntry::GT) {
+                for (unsigned &D : Dir) {
+                    unsigned LT = D & Dependence::DVEntry::LT;
+                    unsigned GT = D & Dependence::DVEntry::GT;
+                    D = (D & Dependence::DVEntry::EQ) | (LT ? Dependence::DVEntry::GT : 0) |
+                        (GT ? Dependence::DVEntry::LT : 0);
+                }
+            }
+            Directions.push_back(Dir);
+        }
+    }
+    return true;
+}
+
+} // namespace loop_nest
+
+#endif // ASSIGNMENT4_LOOP_NEST_H
@@ -0,0 +1,260 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "../common/loop_nest.h"
+
+using namespace llvm;
+using namespace loop_nest;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Widening delle variabili di induzione: un contatore i32 usato per
+// indicizzare la memoria richiede un'estensione a 64 bit in ogni iterazione
+// prima di ogni GEP. Quando SCEV (grazie ai flag nsw/nuw) dimostra che
+// l'estensione del contatore è a sua volta una ricorrenza, il loop riceve
+// una variabile di induzione larga quanto un puntatore che sostituisce le
+// estensioni. I confronti vengono allargati se il limite è invariante,
+// altrimenti usano la variabile stretta ricavata con un trunc.
+namespace {
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+
+    Type *WideTy = F.getParent()->getDataLayout().getIntPtrType(F.getContext());
+
+    bool Changed = false;
+    for (Loop *L : LI.getLoopsInPreorder()) {
+        if (!L->getLoopPreheader() || !L->getLoopLatch())
+            continue;
+        PHINode *IV = getInductionVariable(L, SE);
+        if (!IV || !IV->getType()->isIntegerTy() ||
+            IV->getType()->getIntegerBitWidth() >= WideTy->getIntegerBitWidth())
+            continue;
+        if (widenInductionVariable(L, IV, WideTy, SE)) {
+            SE.forgetLoop(L);
+            Changed = true;
+        }
+    }
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+// Estensioni a WideTy dentro L il cui valore è la variabile di induzione
+// larga più una costante. Un'addizione nsw (nuw) tra IV e una costante si
+// estende operando per operando; negli altri casi decide SCEV, che deve
+// vedere l'estensione come {Start + Offset, +, Step}
+bool getExtensionOffset(CastInst *Ext, Loop *L, PHINode *IV, bool Signed, const SCEVAddRecExpr *WideAR,
+                        ScalarEvolution &SE, int64_t &Offset) {
+    Value *Op = Ext->getOperand(0);
+    if (Op == IV) {
+        Offset = 0;
+        return true;
+    }
+    auto *BO = dyn_cast<BinaryOperator>(Op);
+    auto *C = BO ? dyn_cast<ConstantInt>(BO->getOperand(1)) : nullptr;
+    if (BO && C && BO->getOperand(0) == IV &&
+        (BO->getOpcode() == Instruction::Add || BO->getOpcode() == Instruction::Sub) &&
+        (Signed ? BO->hasNoSignedWrap() : BO->hasNoUnsignedWrap())) {
+        Offset = Signed ? C->getSExtValue() : int64_t(C->getZExtValue());
+        if (BO->getOpcode() == Instruction::Sub)
+            Offset = -Offset;
+        return true;
+    }
+
+    auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ext));
+    if (!AR || AR->getLoop() != L || !AR->isAffine() ||
+        AR->getStepRecurrence(SE) != WideAR->getStepRecurrence(SE))
+        return false;
+    auto *Diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(AR->getStart(), WideAR->getStart()));
+    if (!Diff)
+        return false;
+    Offset = Diff->getAPInt().getSExtValue();
+    return true;
+}
+
+bool widenInductionVariable(Loop *L, PHINode *IV, Type *WideTy, ScalarEvolution &SE) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Latch = L->getLoopLatch();
+
+    InductionDescriptor ID;
+    if (!InductionDescriptor::isInductionPHI(IV, L, &SE, ID) || !ID.getConstIntStepValue())
+        return false;
+    auto *Inc = dyn_cast<BinaryOperator>(IV->getIncomingValueForBlock(Latch));
+    if (!Inc || !L->contains(Inc))
+        return false;
+
+    // L'estensione della ricorrenza stretta deve restare una ricorrenza:
+    // SCEV lo deduce dai flag nsw (sext) o nuw (zext). Il valore incrementato
+    // dell'ultima iterazione può invece uscire dal tipo stretto, e serve
+    // solo alla PHI
+    const SCEV *NarrowSCEV = SE.getSCEV(IV);
+    auto WidenedRec = [&](const SCEV *S, bool Signed) {
+        const SCEV *W = Signed ? SE.getSignExtendExpr(S, WideTy) : SE.getZeroExtendExpr(S, WideTy);
+        auto *AR = dyn_cast<SCEVAddRecExpr>(W);
+        return AR && AR->getLoop() == L && AR->isAffine() ? AR : nullptr;
+    };
+
+    // Si sceglie l'estensione più usata tra quelle che SCEV sa eliminare
+    SmallVector<CastInst *, 8> SExts, ZExts;
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            if (I.getType() != WideTy || !SE.isSCEVable(I.getOperand(0)->getType()))
+                continue;
+            if (auto *SI = dyn_cast<SExtInst>(&I))
+                SExts.push_back(SI);
+            else if (auto *ZI = dyn_cast<ZExtInst>(&I))
+                ZExts.push_back(ZI);
+        }
+    }
+    bool Signed = SExts.size() >= ZExts.size();
+    const SCEVAddRecExpr *WideAR = WidenedRec(NarrowSCEV, Signed);
+    if (!WideAR) {
+        Signed = !Signed;
+        WideAR = WidenedRec(NarrowSCEV, Signed);
+        if (!WideAR)
+            return false;
+    }
+
+    SmallVector<std::pair<CastInst *, int64_t>, 8> Rewrites;
+    for (CastInst *Ext : Signed ? SExts : ZExts) {
+        int64_t Offset;
+        if (getExtensionOffset(Ext, L, IV, Signed, WideAR, SE, Offset))
+            Rewrites.push_back({Ext, Offset});
+    }
+    if (Rewrites.empty()) {
+        errs() << "No extensions of " << IV->getName() << " to remove\n";
+        return false;
+    }
+    errs() << "Widening " << IV->getName() << " in loop " << Header->getName() << ": "
+           << Rewrites.size() << " extensions removed\n";
+
+    // Nuova PHI larga, con l'incremento accanto a quello stretto
+    IRBuilder<> PreBuilder(Preheader->getTerminator());
+    Value *Start = IV->getIncomingValueForBlock(Preheader);
+    Value *WideStart = Signed ? PreBuilder.CreateSExt(Start, WideTy) : PreBuilder.CreateZExt(Start, WideTy);
+    PHINode *WidePHI = PHINode::Create(WideTy, 2, IV->getName() + ".wide", &Header->front());
+    int64_t Step = ID.getConstIntStepValue()->getSExtValue();
+    auto *WideInc = BinaryOperator::CreateAdd(WidePHI, ConstantInt::get(WideTy, Step, true),
+                                              Inc->getName() + ".wide");
+    WideInc->insertAfter(Inc);
+    if (Signed)
+        WideInc->setHasNoSignedWrap(true);
+    else
+        WideInc->setHasNoUnsignedWrap(true);
+    WidePHI->addIncoming(WideStart, Preheader);
+    WidePHI->addIncoming(WideInc, Latch);
+
+    // Le estensioni diventano la PHI larga, l'incremento largo, o la PHI
+    // più una costante; le operazioni strette che le alimentavano restano
+    // senza usi
+    SmallVector<WeakTrackingVH, 8> DeadInsts;
+    for (auto &[Ext, Offset] : Rewrites) {
+        Value *V;
+        if (Ext->getOperand(0) == IV && Offset == 0)
+            V = WidePHI;
+        else if (Ext->getOperand(0) == Inc && Offset == Step)
+            V = WideInc;
+        else if (Offset == 0)
+            V = WidePHI;
+        else {
+            auto *Add = BinaryOperator::CreateAdd(WidePHI, ConstantInt::get(WideTy, Offset, true),
+                                                  Ext->getName() + ".wide", Ext);
+            if (Signed)
+                Add->setHasNoSignedWrap(true);
+            else
+                Add->setHasNoUnsignedWrap(true);
+            V = Add;
+        }
+        Ext->replaceAllUsesWith(V);
+        if (Ext->getOperand(0) != IV && Ext->getOperand(0) != Inc)
+            DeadInsts.push_back(Ext->getOperand(0));
+        Ext->eraseFromParent();
+    }
+
+    // I confronti con un limite invariante diventano confronti larghi se il
+    // predicato è compatibile con l'estensione scelta. Per l'incremento
+    // serve che anche la sua estensione coincida con quello largo.
+    bool IncExtends = (Signed ? Inc->hasNoSignedWrap() : Inc->hasNoUnsignedWrap()) ||
+                      WidenedRec(SE.getSCEV(Inc), Signed);
+    SmallVector<User *, 8> Users(IV->users());
+    if (IncExtends)
+        Users.append(Inc->user_begin(), Inc->user_end());
+    for (User *U : Users) {
+        auto *Cmp = dyn_cast<ICmpInst>(U);
+        if (!Cmp || !L->contains(Cmp))
+            continue;
+        if (!Cmp->isEquality() && Cmp->isSigned() != Signed)
+            continue;
+        unsigned Idx = (Cmp->getOperand(0) == IV || Cmp->getOperand(0) == Inc) ? 0 : 1;
+        Value *Bound = Cmp->getOperand(1 - Idx);
+        if (!L->isLoopInvariant(Bound) || Bound == IV || Bound == Inc)
+            continue;
+        Value *WideBound = Signed ? PreBuilder.CreateSExt(Bound, WideTy) : PreBuilder.CreateZExt(Bound, WideTy);
+        Cmp->setOperand(Idx, Cmp->getOperand(Idx) == IV ? static_cast<Value *>(WidePHI) : WideInc);
+        Cmp->setOperand(1 - Idx, WideBound);
+    }
+
+    // Gli usi rimasti leggono la variabile stretta dal trunc di quella
+    // larga; la PHI stretta e il suo incremento non servono più
+    auto *IVTrunc = new TruncInst(WidePHI, IV->getType(), IV->getName() + ".trunc",
+                                  Header->getFirstNonPHI());
+    auto *IncTrunc = new TruncInst(WideInc, Inc->getType(), Inc->getName() + ".trunc");
+    IncTrunc->insertAfter(WideInc);
+    IV->replaceAllUsesWith(IVTrunc);
+    Inc->replaceAllUsesWith(IncTrunc);
+    IV->eraseFromParent();
+    DeadInsts.append({Inc, IVTrunc, IncTrunc});
+    RecursivelyDeleteTriviallyDeadInstructionsPermissive(DeadInsts);
+    return true;
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "ivWidening", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "iv_widening") {
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
@@ -0,0 +1,42 @@
+#include <stdio.h>
+
+#define N 512
+
+int A[N], B[N + 1], C[N][N];
+
+// Contatore int con nsw: sext(i) e sext(i + 1) diventano la variabile di
+// induzione a 64 bit, e il confronto con n viene allargato
+void test_signed(int n) {
+    for (int i = 0; i < n; i++) {
+        A[i] = B[i] + B[i + 1];
+    }
+}
+
+// Contatore unsigned: le estensioni sono zext e il confronto ult
+unsigned test_unsigned(unsigned n) {
+    unsigned sum = 0;
+    for (unsigned i = 0; i < n; i++) {
+        sum += A[i];
+    }
+    return sum;
+}
+
+// Nest: entrambi i contatori vengono allargati, i resta stretto solo
+// dove serve come valore
+void test_nest(int n) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            C[i][j] = i - j;
+        }
+    }
+}
+
+int main() {
+    for (int i = 0; i <= N; i++)
+        B[i] = i % 11;
+    test_signed(N);
+    unsigned s = test_unsigned(N);
+    test_nest(N);
+    printf("%d %u %d\n", A[N - 1], s, C[100][37]);
+    return 0;
+}
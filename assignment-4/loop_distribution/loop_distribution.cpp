@@ -0,0 +1,489 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "../common/loop_nest.h"
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace loop_nest;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Distribuzione dei loop (l'inverso della fusione): le istruzioni del body
+// vengono divise in partizioni secondo il grafo delle dipendenze, e ogni
+// partizione diventa un loop a sé. Separando le ricorrenze portate dal loop
+// dal resto del body, i loop senza cicli di dipendenze diventano
+// vettorizzabili.
+namespace {
+
+// Ogni partizione ripete il controllo del loop e il calcolo degli indirizzi:
+// oltre questo numero di loop il costo supera il guadagno
+static const unsigned MaxPartitions = 4;
+
+// Istruzioni assegnate a un loop distribuito, in ordine di programma. Cyclic
+// indica un ciclo di dipendenze portato dal loop, che impedisce di
+// vettorizzarlo.
+struct Partition {
+    SmallSetVector<Instruction *, 8> Insts;
+    bool Cyclic = false;
+};
+
+// Vincolo di ordine tra due nodi del grafo: From deve stare in una partizione
+// che precede (o coincide con) quella di To
+struct DependenceEdge {
+    unsigned From;
+    unsigned To;
+    bool Carried;
+};
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &DI = FAM.getResult<DependenceAnalysis>(F);
+
+    // La distribuzione crea nuovi loop: la worklist va costruita prima
+    SmallVector<Loop *, 8> Worklist;
+    for (Loop *TopLevelLoop : LI) {
+        for (Loop *L : depth_first(TopLevelLoop)) {
+            if (L->isInnermost())
+                Worklist.push_back(L);
+        }
+    }
+
+    bool Changed = false;
+    for (Loop *L : Worklist) {
+        if (!isDistributionCandidate(L))
+            continue;
+        PHINode *IV = getInductionVariable(L, SE);
+        if (!IV) {
+            errs() << "Induction variable not found\n";
+            continue;
+        }
+
+        SmallVector<Partition, 4> Partitions;
+        if (!buildPartitions(L, IV, DI, Partitions) || !isDistributionProfitable(Partitions))
+            continue;
+
+        errs() << "Distributing loop " << L->getHeader()->getName() << " into "
+               << Partitions.size() << " loops\n";
+        SE.forgetLoop(L);
+        distributeLoop(L, Partitions, LI);
+        DT.recalculate(F);
+        Changed = true;
+    }
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+// Loop non ruotato, in forma semplificata, in cui l'header decide l'uscita.
+// Il body deve essere un solo blocco e il latch deve contenere solo
+// l'incremento della variabile di induzione, così ogni partizione è fatta di
+// istruzioni del body.
+bool isDistributionCandidate(Loop *L) {
+        if (!isHeaderExitingLoop(L, errs(), "distribution"))
+            return false;
+
+        BasicBlock *Header = L->getHeader();
+        BasicBlock *Latch = L->getLoopLatch();
+        BasicBlock *Body = Header->getTerminator()->getSuccessor(0);
+        if (Body == Latch || L->getNumBlocks() != 3 || Body->getSingleSuccessor() != Latch) {
+            errs() << "Loop body is not a single block\n";
+            return false;
+        }
+        if (!Latch->phis().empty()) {
+            errs() << "Loop latch contains PHI nodes\n";
+            return false;
+        }
+
+        // L'header viene copiato in ogni loop: oltre alle PHI può solo
+        // calcolare la condizione di uscita, senza leggere la memoria
+        for (Instruction &I : *Header) {
+            if (!isa<PHINode>(I) && I.mayReadOrWriteMemory()) {
+                errs() << "Loop header accesses memory\n";
+                return false;
+            }
+        }
+
+        // Chiamate e altre istruzioni con effetti collaterali non si possono
+        // assegnare a una sola partizione
+        for (Instruction &I : *Body) {
+            if (I.mayHaveSideEffects() && !isa<StoreInst>(I)) {
+                errs() << "Loop body has side effects other than stores\n";
+                return false;
+            }
+            if (I.mayReadOrWriteMemory() && !isa<LoadInst>(I) && !isa<StoreInst>(I)) {
+                errs() << "Loop body accesses memory through a call\n";
+                return false;
+            }
+        }
+        return true;
+}
+
+// Costruisce le partizioni in ordine topologico. I nodi del grafo sono gli
+// accessi in memoria del body e le PHI dell'header diverse dalla variabile
+// di induzione; i calcoli intermedi vengono duplicati in ogni loop che li usa.
+bool buildPartitions(Loop *L, PHINode *IV, DependenceInfo &DI, SmallVectorImpl<Partition> &Partitions) {
+    BasicBlock *Latch = L->getLoopLatch();
+    BasicBlock *Body = L->getHeader()->getTerminator()->getSuccessor(0);
+
+    // Il latch può contenere solo l'incremento della variabile di induzione
+    Value *IVNext = IV->getIncomingValueForBlock(Latch);
+    for (Instruction &I : *Latch) {
+        if (&I != IVNext && !I.isTerminator()) {
+            errs() << "Loop latch contains more than the induction variable update\n";
+            return false;
+        }
+    }
+
+    SmallVector<Instruction *, 16> Nodes;
+    std::map<Instruction *, unsigned> NodeIndex;
+    for (PHINode &PN : L->getHeader()->phis()) {
+        if (&PN != IV) {
+            NodeIndex[&PN] = Nodes.size();
+            Nodes.push_back(&PN);
+        }
+    }
+    for (Instruction &I : *Body) {
+        if (isa<LoadInst>(I) || isa<StoreInst>(I)) {
+            NodeIndex[&I] = Nodes.size();
+            Nodes.push_back(&I);
+        }
+    }
+    if (Nodes.size() < 2)
+        return false;
+
+    // 1. Un valore letto dalla memoria o portato da una PHI non può passare
+    // da un loop all'altro: i nodi collegati da def-use finiscono insieme
+    std::vector<unsigned> Leader(Nodes.size());
+    for (unsigned i = 0; i < Nodes.size(); ++i)
+        Leader[i] = i;
+    auto Find = [&](unsigned N) {
+        while (Leader[N] != N)
+            N = Leader[N] = Leader[Leader[N]];
+        return N;
+    };
+    auto Union = [&](unsigned A, unsigned B) { Leader[Find(A)] = Find(B); };
+
+    for (unsigned i = 0; i < Nodes.size(); ++i) {
+        SmallVector<Value *, 8> Worklist;
+        SmallPtrSet<Value *, 16> Visited;
+        if (auto *PN = dyn_cast<PHINode>(Nodes[i]))
+            Worklist.push_back(PN->getIncomingValueForBlock(Latch));
+        else
+            Worklist.append(Nodes[i]->op_begin(), Nodes[i]->op_end());
+
+        while (!Worklist.empty()) {
+            auto *Op = dyn_cast<Instruction>(Worklist.pop_back_val());
+            if (!Op || !L->contains(Op) || Op == IV || Op == IVNext || !Visited.insert(Op).second)
+                continue;
+            auto It = NodeIndex.find(Op);
+            if (It != NodeIndex.end()) {
+                Union(i, It->second);
+                continue;
+            }
+            Worklist.append(Op->op_begin(), Op->op_end());
+        }
+    }
+
+    // 2. Vincoli di ordine dalle dipendenze in memoria
+    SmallVector<DependenceEdge, 16> Edges;
+    BitVector SelfCarried(Nodes.size());
+    unsigned Depth = L->getLoopDepth();
+    for (unsigned i = 0; i < Nodes.size(); ++i) {
+        for (unsigned j = i; j < Nodes.size(); ++j) {
+            Instruction *Src = Nodes[i], *Dst = Nodes[j];
+            if (isa<PHINode>(Src) || isa<PHINode>(Dst))
+                continue;
+            if (!Src->mayWriteToMemory() && !Dst->mayWriteToMemory())
+                continue;
+            auto D = DI.depends(Src, Dst, true);
+            if (!D)
+                continue;
+
+            unsigned Dir = Dependence::DVEntry::ALL;
+            if (!D->isConfused() && D->getLevels() >= Depth) {
+                // Le dipendenze portate da un loop esterno non cambiano
+                // distribuendo quello interno
+                bool OuterCarried = false;
+                for (unsigned Level = 1; Level < Depth; ++Level)
+                    if (!(D->getDirection(Level) & Dependence::DVEntry::EQ))
+                        OuterCarried = true;
+                if (OuterCarried)
+                    continue;
+                Dir = D->getDirection(Depth);
+            }
+
+            if (i == j) {
+                if (Dir & (Dependence::DVEntry::LT | Dependence::DVEntry::GT))
+                    SelfCarried.set(i);
+                continue;
+            }
+            if (Dir & Dependence::DVEntry::LT)
+                Edges.push_back({i, j, true});
+            if (Dir & Dependence::DVEntry::EQ)
+                Edges.push_back({i, j, false});
+            if (Dir & Dependence::DVEntry::GT)
+                Edges.push_back({j, i, true});
+        }
+    }
+
+    // 3. I cicli tra gruppi vanno eseguiti nello stesso loop: si fondono le
+    // componenti fortemente connesse, calcolate dalla chiusura transitiva
+    unsigned N = Nodes.size();
+    std::vector<BitVector> Reach(N, BitVector(N));
+    for (const DependenceEdge &E : Edges)
+        Reach[Find(E.From)].set(Find(E.To));
+    for (unsigned k = 0; k < N; ++k)
+        for (unsigned i = 0; i < N; ++i)
+            if (Reach[i].test(k))
+                Reach[i] |= Reach[k];
+    for (unsigned i = 0; i < N; ++i)
+        for (unsigned j = i + 1; j < N; ++j)
+            if (Find(i) == i && Find(j) == j && Reach[i].test(j) && Reach[j].test(i))
+                Union(j, i);
+
+    // Un gruppo è ciclico se contiene una dipendenza portata dal loop o una
+    // ricorrenza scalare che non è una riduzione
+    BitVector Cyclic(N);
+    for (const DependenceEdge &E : Edges)
+        if (E.Carried && Find(E.From) == Find(E.To))
+            Cyclic.set(Find(E.From));
+    for (unsigned i = 0; i < N; ++i) {
+        if (SelfCarried.test(i))
+            Cyclic.set(Find(i));
+        RecurrenceDescriptor RD;
+        if (auto *PN = dyn_cast<PHINode>(Nodes[i]))
+            if (!RecurrenceDescriptor::isReductionPHI(PN, L, RD))
+                Cyclic.set(Find(i));
+    }
+
+    // 4. Ordine topologico dei gruppi. Tra quelli pronti si preferisce uno
+    // dello stesso tipo dell'ultimo, così il passo successivo può unirli; a
+    // parità si mantiene l'ordine di programma del primo nodo
+    std::vector<unsigned> InDegree(N, 0);
+    std::set<std::pair<unsigned, unsigned>> GroupEdges;
+    for (const DependenceEdge &E : Edges) {
+        unsigned From = Find(E.From), To = Find(E.To);
+        if (From != To && GroupEdges.insert({From, To}).second)
+            ++InDegree[To];
+    }
+    SmallVector<unsigned, 8> Order;
+    BitVector Done(N);
+    while (true) {
+        int Next = -1;
+        for (unsigned i = 0; i < N; ++i) {
+            if (Find(i) != i || Done.test(i) || InDegree[i] != 0)
+                continue;
+            if (Next < 0)
+                Next = i;
+            if (!Order.empty() && Cyclic.test(i) == Cyclic.test(Order.back())) {
+                Next = i;
+                break;
+            }
+        }
+        if (Next < 0)
+            break;
+        Done.set(Next);
+        Order.push_back(Next);
+        for (auto &GE : GroupEdges)
+            if (GE.first == (unsigned)Next)
+                --InDegree[GE.second];
+    }
+    unsigned Groups = 0;
+    for (unsigned i = 0; i < N; ++i)
+        if (Find(i) == i)
+            ++Groups;
+    if (Order.size() != Groups) {
+        errs() << "Dependence graph between partitions is not acyclic\n";
+        return false;
+    }
+
+    // 5. Gruppi consecutivi dello stesso tipo finiscono nello stesso loop:
+    // la distribuzione serve solo a separare le ricorrenze dal resto
+    std::map<unsigned, unsigned> GroupPartition;
+    for (unsigned G : Order) {
+        if (Partitions.empty() || Partitions.back().Cyclic != Cyclic.test(G)) {
+            Partitions.emplace_back();
+            Partitions.back().Cyclic = Cyclic.test(G);
+        }
+        GroupPartition[G] = Partitions.size() - 1;
+    }
+    for (unsigned i = 0; i < N; ++i)
+        Partitions[GroupPartition[Find(i)]].Insts.insert(Nodes[i]);
+    return true;
+}
+
+// Modello di costo: conviene dividere il loop solo se si separa almeno una
+// parte vettorizzabile da una ricorrenza, senza moltiplicare i loop
+bool isDistributionProfitable(ArrayRef<Partition> Partitions) {
+    if (Partitions.size() < 2) {
+        errs() << "Loop has a single partition\n";
+        return false;
+    }
+    if (Partitions.size() > MaxPartitions) {
+        errs() << "Too many partitions (" << Partitions.size() << ")\n";
+        return false;
+    }
+
+    // Una partizione senza cicli che scrive in memoria è un flusso che il
+    // vettorizzatore può trattare
+    bool HasStream = false;
+    for (const Partition &P : Partitions) {
+        if (P.Cyclic)
+            continue;
+        for (Instruction *I : P.Insts)
+            if (isa<StoreInst>(I))
+                HasStream = true;
+    }
+    if (!HasStream) {
+        errs() << "No vectorizable partition with stores\n";
+        return false;
+    }
+    return true;
+}
+
+// Il loop originale esegue l'ultima partizione; ogni altra partizione viene
+// eseguita da una copia inserita prima di esso, nell'ordine delle partizioni
+void distributeLoop(Loop *L, ArrayRef<Partition> Partitions, LoopInfo &LI) {
+    SmallVector<Loop *, 4> Loops;
+    SmallVector<std::unique_ptr<ValueToValueMapTy>, 4> VMaps;
+    for (unsigned P = 0; P + 1 < Partitions.size(); ++P) {
+        VMaps.push_back(std::make_unique<ValueToValueMapTy>());
+        Loops.push_back(cloneLoopBefore(L, *VMaps.back(), LI));
+    }
+    Loops.push_back(L);
+
+    auto Lookup = [&](unsigned P, Instruction *I) -> Instruction * {
+        if (P + 1 == Partitions.size())
+            return I;
+        return cast<Instruction>((*VMaps[P])[I]);
+    };
+
+    // Le PHI vengono usate dopo il loop con il loro valore finale: gli usi
+    // passano alla copia che le esegue
+    for (unsigned P = 0; P + 1 < Partitions.size(); ++P) {
+        for (Instruction *I : Partitions[P].Insts) {
+            if (!isa<PHINode>(I))
+                continue;
+            Instruction *Copy = Lookup(P, I);
+            for (Use &U : make_early_inc_range(I->uses()))
+                if (!L->contains(cast<Instruction>(U.getUser())))
+                    U.set(Copy);
+        }
+    }
+
+    // Ogni loop tiene solo i nodi della sua partizione; i calcoli rimasti
+    // senza usi vengono eliminati
+    for (unsigned P = 0; P < Partitions.size(); ++P) {
+        for (unsigned Other = 0; Other < Partitions.size(); ++Other) {
+            if (Other == P)
+                continue;
+            for (Instruction *I : Partitions[Other].Insts) {
+                Instruction *Copy = Lookup(P, I);
+                if (!Copy->getType()->isVoidTy())
+                    Copy->replaceAllUsesWith(PoisonValue::get(Copy->getType()));
+                Copy->eraseFromParent();
+            }
+        }
+
+        SmallVector<WeakTrackingVH, 16> Dead;
+        for (BasicBlock *BB : Loops[P]->blocks())
+            for (Instruction &I : *BB)
+                if (isInstructionTriviallyDead(&I))
+                    Dead.push_back(&I);
+        RecursivelyDeleteTriviallyDeadInstructions(Dead);
+    }
+}
+
+// Copia L tra il suo preheader e L stesso: la copia esce in un nuovo
+// preheader di L, da cui il loop originale riparte dai valori iniziali
+Loop *cloneLoopBefore(Loop *L, ValueToValueMapTy &VMap, LoopInfo &LI) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Exit = L->getExitBlock();
+    Function *F = Header->getParent();
+
+    SmallVector<BasicBlock *, 8> NewBlocks;
+    for (BasicBlock *BB : L->blocks()) {
+        BasicBlock *NewBB = CloneBasicBlock(BB, VMap, ".dist", F);
+        NewBB->moveBefore(Header);
+        VMap[BB] = NewBB;
+        NewBlocks.push_back(NewBB);
+    }
+    remapInstructionsInBlocks(NewBlocks, VMap);
+    BasicBlock *NewHeader = cast<BasicBlock>(VMap[Header]);
+
+    BasicBlock *NewPreheader = BasicBlock::Create(F->getContext(), Header->getName() + ".dist.ph", F, Header);
+    BranchInst::Create(Header, NewPreheader);
+    NewHeader->getTerminator()->replaceUsesOfWith(Exit, NewPreheader);
+    Preheader->getTerminator()->replaceUsesOfWith(Header, NewHeader);
+    Header->replacePhiUsesWith(Preheader, NewPreheader);
+
+    // La copia è un nuovo loop fratello di L, con l'header aggiunto per primo
+    Loop *NewLoop = LI.AllocateLoop();
+    if (Loop *Parent = L->getParentLoop()) {
+        Parent->addChildLoop(NewLoop);
+        Parent->addBasicBlockToLoop(NewPreheader, LI);
+    } else {
+        LI.addTopLevelLoop(NewLoop);
+    }
+    NewLoop->addBasicBlockToLoop(NewHeader, LI);
+    for (BasicBlock *BB : L->blocks()) {
+        if (BB != Header)
+            NewLoop->addBasicBlockToLoop(cast<BasicBlock>(VMap[BB]), LI);
+    }
+    return NewLoop;
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "loopDistribution", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "loop_distribution") {
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
@@ -0,0 +1,44 @@
+#include <stdio.h>
+
+// a[i + 1] dipende da a[i]: la ricorrenza impedisce di vettorizzare il loop,
+// ma la scrittura di b non ne fa parte e finisce in un loop separato
+void test_recurrence(int *b) {
+    int a[11];
+    a[0] = 1;
+    for (int i = 0; i < 10; i++) {
+        a[i + 1] = a[i] * 3 + 1;
+        b[i] = i * 2;
+    }
+    printf("%d\n", a[10]);
+}
+
+// Il flusso legge i valori prodotti dalla ricorrenza: il loop della
+// ricorrenza deve venire prima
+void test_ordered(int *b) {
+    int a[11];
+    a[0] = 1;
+    for (int i = 0; i < 10; i++) {
+        a[i + 1] = a[i] * 3 + 1;
+        b[i] = a[i + 1] * 2;
+    }
+}
+
+// Ricorrenza scalare che non è una riduzione: il suo valore finale viene
+// letto dal loop che la calcola
+int test_scalar_recurrence(int *c) {
+    int s = 0;
+    for (int i = 0; i < 10; i++) {
+        s = s * 3 + i;
+        c[i] = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    int b[10], c[10];
+    test_recurrence(b);
+    test_ordered(b);
+    int s = test_scalar_recurrence(c);
+    printf("%d %d %d\n", b[7], c[5], s);
+    return 0;
+}
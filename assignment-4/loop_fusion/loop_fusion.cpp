@@ -9,18 +9,75 @@
 #include "llvm/IR/Dominators.h"
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/DomTreeUpdater.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+#include "llvm/ADT/MapVector.h"
+#include "../common/loop_nest.h"
+#include <limits>
+#include <map>
+#include <optional>
 #include <set>
 
 using namespace llvm;
+using namespace loop_nest;
+
+#define DEBUG_TYPE "loop-fusion"
 
 //-----------------------------------------------------------------------------
 // TestPass implementation
 //-----------------------------------------------------------------------------
 namespace {
 
+// Oltre questo numero di iterazioni il peeling non vale la copia del loop
+static const int64_t MaxPeelCount = 8;
+
+// Flussi di memoria che il prefetcher hardware segue contemporaneamente:
+// oltre questo numero il loop fuso perde il prefetch su alcuni array
+static const unsigned MaxMemoryStreams = 16;
+// Distanza in byte entro cui un dato riletto dal secondo loop è ancora in
+// cache, se TargetTransformInfo non conosce la dimensione della cache L1
+static const int64_t DefaultReuseDistance = 32 * 1024;
+// Fattore di unroll-and-jam se la pipeline non ne indica uno
+static const unsigned DefaultUnrollAndJamFactor = 4;
+
+// Accessi in memoria di un loop, raggruppati per oggetto sottostante
+using MemoryGroups = MapVector<const Value *, SmallVector<Instruction *, 4>>;
+
 struct TestPass : PassInfoMixin<TestPass> {
+  // Cache valide per la funzione corrente: gruppi di accessi per loop e
+  // distanza minima delle dipendenze per coppia di loop
+  std::map<Loop *, MemoryGroups> MemoryAccesses;
+  std::map<std::pair<Loop *, Loop *>, std::optional<int64_t>> DependenceCache;
+  // Loop prodotti dal peeling: non vengono divisi una seconda volta, così
+  // la fusione fino al punto fisso non continua a spezzare gli stessi loop
+  std::set<Loop *> PeeledLoops;
+  // Copie create dal controllo a runtime sui trip count: mantengono la
+  // sequenza originale e non vengono fuse
+  std::set<Loop *> SlowPathLoops;
+  // Loop prodotti dalla fusione, su cui si tenta la contrazione degli array
+  std::set<Loop *> FusedLoops;
+  // Con trip count simbolici diversi si fonde dietro un controllo TC0 == TC1
+  bool RuntimeTripCountCheck;
+  // Se maggiore di 1, invece di fondere i loop fratelli si esegue
+  // l'unroll-and-jam dei nest con questo fattore
+  unsigned UnrollAndJamFactor;
+  // Analisi per il modello di costo, valide per la funzione corrente
+  TargetTransformInfo *TTI = nullptr;
+  OptimizationRemarkEmitter *ORE = nullptr;
+
+  TestPass(bool RuntimeTripCountCheck = false, unsigned UnrollAndJamFactor = 0)
+      : RuntimeTripCountCheck(RuntimeTripCountCheck), UnrollAndJamFactor(UnrollAndJamFactor) {}
+
   // Main entry point per il nuovo Pass Manager
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
 
@@ -31,72 +88,516 @@ struct TestPass : PassInfoMixin<TestPass> {
     auto &PDT = FAM.getResult<PostDominatorTreeAnalysis>(F);
     auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
     auto &DI = FAM.getResult<DependenceAnalysis>(F);
+    auto &AA = FAM.getResult<AAManager>(F);
+    TTI = &FAM.getResult<TargetIRAnalysis>(F);
+    ORE = &FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+
+    MemoryAccesses.clear();
+    DependenceCache.clear();
+    PeeledLoops.clear();
+    SlowPathLoops.clear();
+    FusedLoops.clear();
+
+    // Le modifiche al CFG aggiornano i due alberi in modo incrementale:
+    // vengono applicate solo quando servono per valutare la coppia successiva
+    DomTreeUpdater DTU(DT, PDT, DomTreeUpdater::UpdateStrategy::Lazy);
+
+    // Si parte dai loop più esterni: fondere due nest mette i loro loop
+    // interni uno dopo l'altro, e questi vengono poi fusi a loro volta
+    bool Changed = UnrollAndJamFactor > 1 ? unrollAndJamNests(F, LI, DTU, SE, DI, AA)
+                                          : fuseSiblings(F, nullptr, LI, DTU, SE, DI, AA);
+    if (Changed)
+        contractArrays(F, LI, DTU.getDomTree(), SE);
+    DTU.flush();
+
+    if (!Changed)
+        return PreservedAnalyses::all();
+    PreservedAnalyses PA;
+    PA.preserve<LoopAnalysis>();
+    PA.preserve<DominatorTreeAnalysis>();
+    PA.preserve<PostDominatorTreeAnalysis>();
+    return PA;
+}
 
+// Fonde i figli di Parent (i loop top-level se Parent è nullptr), poi scende
+// ricorsivamente nei figli dei loop risultanti
+bool fuseSiblings(Function &F, Loop *Parent, LoopInfo &LI, DomTreeUpdater &DTU,
+                  ScalarEvolution &SE, DependenceInfo &DI, AAResults &AA) {
     bool Changed = false;
+    SmallVector<Loop *, 8> Worklist;
+
+    // Fusione fino al punto fisso: dopo ogni fusione il loop risultante torna
+    // candidato con il suo successore, così catene di 3 o più loop adiacenti
+    // diventano un solo loop
+    bool FusedInRound = true;
+    while (FusedInRound) {
+        FusedInRound = false;
+
+        // Loop fratelli in ordine di programma. I loop creati dal peeling
+        // finiscono in fondo alle liste di LoopInfo: l'ordine si ricava dalla
+        // visita dell'albero dei dominatori
+        Worklist.clear();
+        errs() << "Iterating over loops in the function...\n";
+        if (Parent)
+            Worklist.append(Parent->begin(), Parent->end());
+        else
+            Worklist.append(LI.begin(), LI.end());
+        DominatorTree &DT = DTU.getDomTree();
+        DT.updateDFSNumbers();
+        llvm::sort(Worklist, [&](Loop *A, Loop *B) {
+            return DT.getNode(A->getHeader())->getDFSNumIn() <
+                   DT.getNode(B->getHeader())->getDFSNumIn();
+        });
+
+        errs() << "Checking adjacent loops for fusion...\n";
+        size_t i = 0;
+        while (i + 1 < Worklist.size()) {
+            Loop *L0 = Worklist[i];
+            Loop *L1 = Worklist[i + 1];
+
+            Loop *Fused = tryFuseLoops(F, L0, L1, LI, DTU, SE, DI, AA);
+            if (!Fused) {
+                ++i;
+                continue;
+            }
 
-    // Itera su tutti i loop nella funzione
+            errs() << "Successfully fused loops " << i << " and " << i + 1 << ".\n";
+            Changed = true;
+            FusedInRound = true;
+
+            // L1 non esiste più: il loop fuso (che dopo il peeling in testa
+            // non è più L0) prende la posizione i e viene confrontato con il
+            // successivo
+            Worklist[i] = Fused;
+            Worklist.erase(Worklist.begin() + i + 1);
+        }
+    }
+
+    for (Loop *L : Worklist) {
+        if (!L->isInnermost())
+            Changed |= fuseSiblings(F, L, LI, DTU, SE, DI, AA);
+    }
+    return Changed;
+}
+
+// Unroll-and-jam dei nest di due loop: il loop esterno viene srotolato di
+// UnrollAndJamFactor, e le copie del loop interno che si trovano una dopo
+// l'altra nel suo body vengono fuse con la stessa logica dei loop fratelli.
+// Le letture del loop interno restano così in registro per più iterazioni
+// del loop esterno.
+bool unrollAndJamNests(Function &F, LoopInfo &LI, DomTreeUpdater &DTU, ScalarEvolution &SE,
+                       DependenceInfo &DI, AAResults &AA) {
+    // L'unroll crea nuovi loop: i nest vanno raccolti prima
     SmallVector<Loop *, 8> Worklist;
-    errs() << "Iterating over loops in the function...\n";
     for (Loop *TopLevelLoop : LI) {
         for (Loop *L : depth_first(TopLevelLoop)) {
-            if (L->isInnermost()) {
+            if (L->getSubLoops().size() == 1 && L->getSubLoops().front()->isInnermost())
                 Worklist.push_back(L);
-                }
-            }
+        }
     }
 
-    // Ordina i loop secondo l'ordine di dominanza
-    llvm::sort(Worklist, [&](Loop *A, Loop *B) {
-        return DT.dominates(A->getHeader(), B->getHeader());
-    });
+    bool Changed = false;
+    for (Loop *L : Worklist)
+        Changed |= tryUnrollAndJam(F, L, LI, DTU, SE, DI, AA);
+    return Changed;
+}
+
+bool tryUnrollAndJam(Function &F, Loop *L, LoopInfo &LI, DomTreeUpdater &DTU, ScalarEvolution &SE,
+                     DependenceInfo &DI, AAResults &AA) {
+    Loop *Inner = L->getSubLoops().front();
+    if (!isLoopFusionCandidate(L) || !isLoopFusionCandidate(Inner))
+        return false;
+
+    // L'header contiene solo il controllo del loop e il latch solo
+    // l'incremento: ogni altra PHI andrebbe propagata tra le copie
+    PHINode *IV = getInductionVariable(L, SE);
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    auto *Next = IV ? dyn_cast<BinaryOperator>(IV->getIncomingValueForBlock(Latch)) : nullptr;
+    if (!Next || Next->getOpcode() != Instruction::Add || Next->getOperand(0) != IV ||
+        !isa<ConstantInt>(Next->getOperand(1)) || Header->size() != 3 || Latch->size() != 2) {
+        errs() << "Outer loop control is not a simple increment\n";
+        return false;
+    }
+
+    // Le copie del loop interno devono avere lo stesso trip count per essere
+    // fuse senza peeling
+    const SCEV *InnerTC = getTripCount(Inner, SE);
+    if (!InnerTC || !SE.isLoopInvariant(InnerTC, L)) {
+        errs() << "Inner trip count depends on the outer loop\n";
+        return false;
+    }
+
+    auto *TC = dyn_cast_or_null<SCEVConstant>(SE.getExitCount(L, Header));
+    if (!TC || TC->getAPInt().ult(UnrollAndJamFactor)) {
+        errs() << "Outer trip count is unknown or smaller than the unroll factor\n";
+        return false;
+    }
+
+    // Un nest srotolato ma non fuso è solo più grande: la fusione delle
+    // copie va verificata prima di toccare il loop
+    if (!canJamInnerLoops(L, Inner, DI))
+        return false;
+
+    errs() << "Unroll-and-jam of loop " << Header->getName() << " by " << UnrollAndJamFactor << "\n";
+    SE.forgetLoop(L);
+    invalidateLoopCaches(L);
+    invalidateLoopCaches(Inner);
+
+    // Le iterazioni in eccesso rispetto a un multiplo del fattore restano
+    // in un loop separato davanti: nel loop srotolato il controllo
+    // dell'header cade sempre su un multiplo del fattore
+    uint64_t Remainder = TC->getAPInt().urem(UnrollAndJamFactor);
+    if (Remainder != 0) {
+        errs() << "Peeling " << Remainder << " iterations from the front of the outer loop\n";
+        L = splitLoop(L, ConstantInt::get(TC->getType(), Remainder), LI, DTU, SE);
+        // La copia ha lo stesso header: l'unica PHI è la variabile di induzione
+        IV = cast<PHINode>(&L->getHeader()->front());
+    }
+
+    unrollOuterLoop(L, IV, UnrollAndJamFactor, LI, DTU);
+    if (!fuseSiblings(F, L, LI, DTU, SE, DI, AA) || L->getSubLoops().size() != 1)
+        errs() << "Inner loop copies could not all be jammed\n";
+    return true;
+}
 
-    errs() << "Checking adjacent loops for fusion...\n";
-    for (size_t i = 0; i + 1 < Worklist.size(); ++i) {
-        Loop *L0 = Worklist[i];
-        Loop *L1 = Worklist[i + 1];
+// Le copie del loop interno create dall'unroll si possono fondere se:
+// - tra un loop interno e il successivo c'è solo codice che la fusione sa
+//   spostare (sopra la copia precedente o sotto quella successiva);
+// - nessuna dipendenza va da (i, j) a (i + 1, j - k): nel loop fuso
+//   l'iterazione (i + 1, j - k) viene eseguita prima di (i, j).
+bool canJamInnerLoops(Loop *L, Loop *Inner, DependenceInfo &DI) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    BasicBlock *Preheader = Inner->getLoopPreheader();
+    BasicBlock *Exit = Inner->getExitBlock();
+    if (!Preheader || !Exit) {
+        errs() << "Inner loop has no preheader or single exit\n";
+        return false;
+    }
+    for (BasicBlock *BB : L->blocks()) {
+        if (BB != Header && BB != Latch && BB != Preheader && BB != Exit && !Inner->contains(BB)) {
+            errs() << "Outer loop body has control flow around the inner loop\n";
+            return false;
+        }
+    }
 
-        if(!isLoopFusionCandidate(L0) || !isLoopFusionCandidate(L1)) 
+    // Dopo l'unroll il codice dopo il loop interno e quello prima della sua
+    // copia successiva finiscono nello stesso blocco, in quest'ordine
+    SmallVector<Instruction *, 8> ToHoist, ToSink;
+    for (BasicBlock *BB : {Exit, Preheader}) {
+        if (BB == Header || BB == Latch)
             continue;
+        for (Instruction &I : *BB) {
+            if (&I == BB->getTerminator())
+                break;
+            if (isa<PHINode>(I) || I.mayThrow() || !I.willReturn() || I.isVolatile() || I.isAtomic()) {
+                errs() << "Code between the inner loop copies cannot be moved: " << I << "\n";
+                return false;
+            }
+            bool OperandsHoisted = all_of(I.operands(), [&](Value *Op) {
+                auto *OpInst = dyn_cast<Instruction>(Op);
+                return !OpInst || (OpInst->getParent() != Exit && OpInst->getParent() != Preheader) ||
+                       is_contained(ToHoist, OpInst);
+            });
+            if (OperandsHoisted && canHoistInterveningInst(I, Inner, DI, ToHoist, ToSink)) {
+                ToHoist.push_back(&I);
+            } else if (canSinkInterveningInst(I, Inner, DI, ToHoist)) {
+                ToSink.push_back(&I);
+            } else {
+                errs() << "Code between the inner loop copies depends on both of them: " << I << "\n";
+                return false;
+            }
+        }
+    }
 
-        if( areLoopsAdjacent(L0,L1,DT,LI) && 
-            areControlFlowEquivalent(L0, L1, DT, PDT) && 
-            equalTripCount(L0, L1, SE) &&
-            controlDependencies(L0, L1, DI) ) 
-            {
-                //loop fusion logic 
-                errs() << "Loop " << i << " and Loop " << i + 1 << " can be fused.\n";
-                
-                bool fused = fuseLoops(L0, L1, LI);
-                
-                if (fused) {
-                    Changed = true;
-                    EliminateUnreachableBlocks(F);
-                    errs() << "Successfully fused loops " << i << " and " << i + 1 << ".\n";
-                } else {
-                    errs() << "Failed to fuse loops " << i << " and " << i + 1 << ".\n";
-                }
+    SmallVector<Instruction *, 16> MemInsts;
+    for (BasicBlock *BB : Inner->blocks())
+        for (Instruction &I : *BB)
+            if (I.mayReadOrWriteMemory())
+                MemInsts.push_back(&I);
+
+    unsigned OuterLevel = L->getLoopDepth();
+    for (size_t A = 0; A < MemInsts.size(); ++A) {
+        for (size_t B = A; B < MemInsts.size(); ++B) {
+            Instruction *Src = MemInsts[A];
+            Instruction *Dst = MemInsts[B];
+            if (!Src->mayWriteToMemory() && !Dst->mayWriteToMemory())
+                continue;
+            std::unique_ptr<Dependence> D = DI.depends(Src, Dst, true);
+            if (!D)
+                continue;
+            if (D->isConfused() || D->getLevels() <= OuterLevel) {
+                errs() << "Unknown dependence between " << *Src << " and " << *Dst << "\n";
+                return false;
             }
+            // La direzione può essere riportata in entrambi i versi
+            unsigned OuterDir = D->getDirection(OuterLevel);
+            unsigned InnerDir = D->getDirection(OuterLevel + 1);
+            if (((OuterDir & Dependence::DVEntry::LT) && (InnerDir & Dependence::DVEntry::GT)) ||
+                ((OuterDir & Dependence::DVEntry::GT) && (InnerDir & Dependence::DVEntry::LT))) {
+                errs() << "Dependence between " << *Src << " and " << *Dst
+                       << " prevents jamming the inner loops\n";
+                return false;
+            }
+        }
     }
+    return true;
+}
+
+// Srotola L di Factor: il body (tutti i blocchi tranne header e latch)
+// viene copiato Factor - 1 volte prima del latch, e nella copia k la
+// variabile di induzione vale IV + k * passo. Il trip count deve essere un
+// multiplo di Factor.
+void unrollOuterLoop(Loop *L, PHINode *IV, unsigned Factor, LoopInfo &LI, DomTreeUpdater &DTU) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    auto *Next = cast<BinaryOperator>(IV->getIncomingValueForBlock(Latch));
+    auto *Step = cast<ConstantInt>(Next->getOperand(1));
+    Function *F = Header->getParent();
+
+    SmallVector<BasicBlock *, 8> BodyBlocks;
+    for (BasicBlock *BB : L->blocks())
+        if (BB != Header && BB != Latch)
+            BodyBlocks.push_back(BB);
+    // Blocchi che saltano al latch nel body originale e nell'ultima copia
+    // creata. Il body originale viene collegato alla prima copia solo alla
+    // fine: le copie successive lo clonano e devono ancora saltare al latch.
+    SmallVector<BasicBlock *, 4> OrigLatchPreds(predecessors(Latch));
+    SmallVector<BasicBlock *, 4> LatchPreds;
+
+    SmallVector<DominatorTree::UpdateType, 16> Updates;
+    SmallVector<BasicBlock *, 4> CopyBodies;
+    for (unsigned k = 1; k < Factor; ++k) {
+        ValueToValueMapTy VMap;
+        Instruction *CopyIV = BinaryOperator::CreateAdd(
+            IV, ConstantInt::get(IV->getType(), Step->getValue() * k), IV->getName() + ".unroll");
+        VMap[IV] = CopyIV;
 
-    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+        SmallVector<BasicBlock *, 8> NewBlocks;
+        for (BasicBlock *BB : BodyBlocks) {
+            BasicBlock *NewBB = CloneBasicBlock(BB, VMap, ".unroll", F);
+            NewBB->moveBefore(Latch);
+            VMap[BB] = NewBB;
+            NewBlocks.push_back(NewBB);
+        }
+        remapInstructionsInBlocks(NewBlocks, VMap);
+        BasicBlock *NewBody = cast<BasicBlock>(VMap[getBody(L)]);
+        CopyIV->insertBefore(&*NewBody->getFirstInsertionPt());
+        CopyBodies.push_back(NewBody);
+
+        // La copia precedente prosegue nella nuova invece che nel latch
+        for (BasicBlock *Pred : LatchPreds) {
+            Pred->getTerminator()->replaceUsesOfWith(Latch, NewBody);
+            Updates.push_back({DominatorTree::Delete, Pred, Latch});
+            Updates.push_back({DominatorTree::Insert, Pred, NewBody});
+        }
+        addSuccessorEdges(NewBlocks, Updates);
+
+        for (BasicBlock *BB : BodyBlocks)
+            if (LI.getLoopFor(BB) == L)
+                L->addBasicBlockToLoop(cast<BasicBlock>(VMap[BB]), LI);
+        for (Loop *Sub : SmallVector<Loop *, 2>(L->begin(), L->end()))
+            if (VMap.count(Sub->getHeader()))
+                addClonedLoop(Sub, VMap, LI);
+
+        LatchPreds.clear();
+        for (BasicBlock *Pred : OrigLatchPreds)
+            LatchPreds.push_back(cast<BasicBlock>(VMap[Pred]));
+    }
+    for (BasicBlock *Pred : OrigLatchPreds) {
+        Pred->getTerminator()->replaceUsesOfWith(Latch, CopyBodies.front());
+        Updates.push_back({DominatorTree::Delete, Pred, Latch});
+        Updates.push_back({DominatorTree::Insert, Pred, CopyBodies.front()});
+    }
+    DTU.applyUpdatesPermissive(Updates);
+
+    // L'uscita di ogni copia del loop interno diventa il preheader della
+    // successiva: i due loop sono adiacenti e il codice tra loro può essere
+    // spostato dalla fusione
+    for (BasicBlock *NewBody : CopyBodies)
+        MergeBlockIntoPredecessor(NewBody, &DTU, &LI);
+
+    Next->setOperand(1, ConstantInt::get(IV->getType(), Step->getValue() * Factor));
+}
+
+// Restituisce il loop fuso, o nullptr se L0 e L1 non possono essere fusi
+Loop *tryFuseLoops(Function &F, Loop *L0, Loop *L1, LoopInfo &LI, DomTreeUpdater &DTU,
+                   ScalarEvolution &SE, DependenceInfo &DI, AAResults &AA) {
+    // Applica le modifiche al CFG ancora in sospeso
+    DominatorTree &DT = DTU.getDomTree();
+    PostDominatorTree &PDT = DTU.getPostDomTree();
+
+    if(!isLoopFusionCandidate(L0) || !isLoopFusionCandidate(L1))
+        return nullptr;
+
+    // Istruzioni tra i due loop: se non dipendono dai loop vengono spostate
+    // prima di L0 o dopo L1, rendendo i loop adiacenti
+    SmallVector<Instruction *, 4> ToHoist, ToSink;
+    if (!collectInterveningCode(L0, L1, DI, ToHoist, ToSink))
+        return nullptr;
+
+    if( !areLoopsAdjacent(L0,L1,DT,LI,ToHoist.size() + ToSink.size()) ||
+        !areControlFlowEquivalent(L0, L1, DT, PDT) )
+        return nullptr;
+
+    const SCEV *TC0 = getTripCount(L0, SE);
+    const SCEV *TC1 = getTripCount(L1, SE);
+    Instruction *ExpandPt = L0->getLoopPreheader()->getTerminator();
+    SCEVExpander Expander(SE, F.getParent()->getDataLayout(), "fusion");
+
+    // Trip count che differiscono di una costante: le iterazioni in eccesso
+    // del loop più lungo vengono separate con il peeling. Se non sono
+    // confrontabili a compile time si può fondere la sola versione in cui
+    // risultano uguali a runtime.
+    bool NeedsGuard = false;
+    std::optional<int64_t> TripCountDiff = getTripCountDifference(L0, L1, SE);
+    if (!TripCountDiff) {
+        if (!RuntimeTripCountCheck || !canGuardTripCounts(L0, L1, TC0, TC1, ExpandPt, Expander))
+            return nullptr;
+        NeedsGuard = true;
+        TripCountDiff = 0;
+    }
+    int64_t Diff = *TripCountDiff;
+
+    // Se L0 è più lungo si separano le sue prime Diff iterazioni (le
+    // iterazioni di L1 non possono precedere L0): nel loop fuso L0 è avanti
+    // di Diff iterazioni. Se è più lungo L1 si separano le sue ultime.
+    int64_t Offset = Diff > 0 ? Diff : 0;
+    if (Diff != 0 && !canPeel(Diff > 0 ? L0 : L1, Diff > 0 ? Diff : -Diff))
+        return nullptr;
+
+    // Il trip count di L0 limita la parte di L1 da fondere
+    if (Diff < 0 && !Expander.isSafeToExpandAt(TC0, ExpandPt)) {
+        errs() << "Trip count of Loop 0 cannot be expanded\n";
+        return nullptr;
+    }
+
+    std::optional<IVRewrite> Rewrite = getIVRewrite(L0, L1, Offset, SE);
+    if (!Rewrite || !controlDependencies(L0, L1, DI, AA, SE, Offset))
+        return nullptr;
+
+    if (!canMoveHeaderPHIs(L0, L1))
+        return nullptr;
+
+    if (!isFusionProfitable(L0, L1, SE))
+        return nullptr;
+
+    //loop fusion logic
+    errs() << "Loop " << L0->getHeader()->getName() << " and Loop "
+           << L1->getHeader()->getName() << " can be fused.\n";
+    ORE->emit([&]() {
+        return OptimizationRemark(DEBUG_TYPE, "Fused", L0->getStartLoc(), L0->getHeader())
+               << "fused with the following loop";
+    });
+
+    // Le informazioni di SCEV sui due loop non saranno più valide
+    SE.forgetLoop(L0);
+    SE.forgetLoop(L1);
+
+    moveInterveningCode(L0, L1, ToHoist, ToSink);
+
+    if (NeedsGuard) {
+        errs() << "Guarding fusion with a runtime trip count check\n";
+        Value *TC0Value = Expander.expandCodeFor(TC0, TC0->getType(), ExpandPt);
+        Value *TC1Value = Expander.expandCodeFor(TC1, TC1->getType(), ExpandPt);
+        guardTripCounts(L0, L1, TC0Value, TC1Value, LI, DTU);
+    }
+
+    // Il peeling dal fondo cambia la condizione di uscita di L1: la sua
+    // variabile di induzione va cercata prima
+    PHINode *IV1 = getInductionVariable(L1, SE);
+
+    if (Diff > 0) {
+        errs() << "Peeling " << Diff << " iterations from the front of Loop 0\n";
+        Loop *Rest = splitLoop(L0, ConstantInt::get(TC0->getType(), Diff), LI, DTU, SE);
+        invalidateLoopCaches(L0);
+        L0 = Rest;
+    } else if (Diff < 0) {
+        errs() << "Peeling " << -Diff << " iterations from the back of Loop 1\n";
+        Value *Count = Expander.expandCodeFor(TC0, TC0->getType(), ExpandPt);
+        splitLoop(L1, Count, LI, DTU, SE);
+    }
+
+    // Il loop fuso contiene gli accessi di entrambi: i gruppi si uniscono
+    // invece di essere ricalcolati
+    MemoryGroups Merged = getMemoryGroups(L0);
+    for (auto &G : getMemoryGroups(L1))
+        Merged[G.first].append(G.second.begin(), G.second.end());
+    invalidateLoopCaches(L0);
+    invalidateLoopCaches(L1);
+
+    if (!fuseLoops(L0, L1, getInductionVariable(L0, SE), IV1, LI, DTU, *Rewrite)) {
+        errs() << "Failed to fuse loops.\n";
+        return nullptr;
+    }
+    PeeledLoops.erase(L1);
+    FusedLoops.erase(L1);
+    FusedLoops.insert(L0);
+
+    // Header e latch di L1 vengono eliminati: i loro accessi spariscono
+    for (auto &G : Merged)
+        llvm::erase_if(G.second, [&](Instruction *I) { return !L0->contains(I->getParent()); });
+    MemoryAccesses[L0] = std::move(Merged);
+
+    EliminateUnreachableBlocks(F, &DTU);
+    return L0;
 }
 
 bool isLoopFusionCandidate(Loop* L){
-        // Check if the loop has a preheader, header, latch, exiting block and exit block
-        if (!L->getLoopPreheader() || !L->getHeader() || !L->getLoopLatch() || !L->getExitingBlock() || !L->getExitBlock()) {
-            outs()<<"Loop is not a candidate for fusion\n";
+        // Fusione e peeling lavorano su loop non ruotati: l'header decide
+        // se uscire e il suo primo successore è il body
+        if (!isHeaderExitingLoop(L, outs(), "fusion"))
             return false;
-        } 
 
-        // Check if the loop is in a simplified form
-        if (!L->isLoopSimplifyForm()) {
-            outs()<<"Loop is not in a simplified form\n";
+        // Il body dell'altro loop viene inserito prima del latch: se
+        // coincidono non si può
+        if (getBody(L) == L->getLoopLatch()) {
+            outs()<<"Loop body coincides with the latch\n";
+            return false;
+        }
+
+        // Con la fusione i predecessori dei due latch cambiano: PHI nel
+        // latch resterebbero con archi sbagliati
+        if (!L->getLoopLatch()->phis().empty()) {
+            outs()<<"Loop latch contains PHI nodes\n";
             return false;
         }
         return true;
 }
 
-bool areLoopsAdjacent(Loop *L0, Loop *L1, DominatorTree &DT, LoopInfo &LI) {
+// Le PHI dell'header di L1 diverse dalla variabile di induzione (riduzioni,
+// ricorrenze) passano nell'header di L0, che deve poterle alimentare
+bool canMoveHeaderPHIs(Loop *L0, Loop *L1) {
+    // Un valore calcolato in L0 e letto da L1 è, nel loop fuso, quello
+    // dell'iterazione corrente e non quello finale
+    for (BasicBlock *BB : L0->blocks())
+        for (Instruction &I : *BB)
+            for (User *U : I.users())
+                if (auto *UI = dyn_cast<Instruction>(U))
+                    if (L1->contains(UI->getParent())) {
+                        errs() << "Loop 1 uses " << I.getName() << " computed by Loop 0\n";
+                        return false;
+                    }
+
+    // L'header di L1 viene eliminato: oltre alle PHI può contenere solo il
+    // calcolo della condizione di uscita
+    BasicBlock *Header1 = L1->getHeader();
+    for (Instruction &I : *Header1) {
+        if (isa<PHINode>(I) || I.isTerminator())
+            continue;
+        for (User *U : I.users())
+            if (cast<Instruction>(U)->getParent() != Header1) {
+                errs() << "Loop 1 header computes " << I.getName() << " used elsewhere\n";
+                return false;
+            }
+    }
+    return true;
+}
+
+// MovableInsts è il numero di istruzioni nel blocco tra i due loop che
+// verranno spostate altrove
+bool areLoopsAdjacent(Loop *L0, Loop *L1, DominatorTree &DT, LoopInfo &LI, size_t MovableInsts) {
     errs() << "Checking if loops are adjacent...\n";
 
     errs() << "L0 is guarded: " << L0->isGuarded() << "\n";
@@ -136,7 +637,8 @@ bool areLoopsAdjacent(Loop *L0, Loop *L1, DominatorTree &DT, LoopInfo &LI) {
     }
 
     //Controlla che nel preheader di L1 ossia B1 sia presente solo la branch NON condizionale
-    if(B1->size() == 1) {
+    //(oltre alle istruzioni che verranno spostate)
+    if(B1->size() == 1 + MovableInsts) {
         if (const auto *BI = dyn_cast<BranchInst>(B1->getTerminator())) {
             errs() << "Preheader of Loop1 doesn't contain only a branch instrucion.\n";
             return BI->isUnconditional();
@@ -148,6 +650,118 @@ bool areLoopsAdjacent(Loop *L0, Loop *L1, DominatorTree &DT, LoopInfo &LI) {
     return false;
 }
 
+// Divide le istruzioni del preheader di L1 in quelle da spostare nel
+// preheader di L0 (prima di L0) e quelle da spostare nell'uscita di L1 (dopo
+// L1). Restituisce false se qualcuna non può essere spostata.
+bool collectInterveningCode(Loop *L0, Loop *L1, DependenceInfo &DI,
+                            SmallVectorImpl<Instruction *> &ToHoist,
+                            SmallVectorImpl<Instruction *> &ToSink) {
+    BasicBlock *Preheader1 = L1->getLoopPreheader();
+    if (!Preheader1 || L0->getExitBlock() != Preheader1 || L0->isGuarded())
+        return true;
+
+    for (Instruction &I : *Preheader1) {
+        if (&I == Preheader1->getTerminator())
+            break;
+        if (isa<PHINode>(I) || I.mayThrow() || !I.willReturn() || I.isVolatile() || I.isAtomic()) {
+            errs() << "Intervening instruction cannot be moved: " << I << "\n";
+            return false;
+        }
+
+        if (canHoistInterveningInst(I, L0, DI, ToHoist, ToSink)) {
+            ToHoist.push_back(&I);
+        } else if (canSinkInterveningInst(I, L1, DI, ToHoist)) {
+            ToSink.push_back(&I);
+        } else {
+            errs() << "Intervening instruction depends on both loops: " << I << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool canHoistInterveningInst(Instruction &I, Loop *L0, DependenceInfo &DI,
+                             ArrayRef<Instruction *> ToHoist, ArrayRef<Instruction *> ToSink) {
+    // Prima di L0 l'istruzione viene eseguita anche se L0 non termina
+    if (!I.mayReadOrWriteMemory() && !isSafeToSpeculativelyExecute(&I))
+        return false;
+
+    // Gli operandi devono essere disponibili prima di L0
+    for (Value *Op : I.operands()) {
+        auto *OpInst = dyn_cast<Instruction>(Op);
+        if (!OpInst)
+            continue;
+        if (L0->contains(OpInst->getParent()))
+            return false;
+        if (OpInst->getParent() == I.getParent() && !is_contained(ToHoist, OpInst))
+            return false;
+    }
+
+    if (!I.mayReadOrWriteMemory())
+        return true;
+
+    // Né L0 né le istruzioni che restano dopo di lei possono toccare la
+    // stessa memoria
+    for (BasicBlock *BB : L0->blocks()) {
+        for (Instruction &LoopI : *BB) {
+            if (mayConflict(LoopI, I, DI))
+                return false;
+        }
+    }
+    for (Instruction *Sunk : ToSink) {
+        if (mayConflict(*Sunk, I, DI))
+            return false;
+    }
+    return true;
+}
+
+bool canSinkInterveningInst(Instruction &I, Loop *L1, DependenceInfo &DI,
+                            ArrayRef<Instruction *> ToHoist) {
+    // Dopo L1 l'istruzione non può avere usi dentro L1
+    for (User *U : I.users()) {
+        if (L1->contains(cast<Instruction>(U)->getParent()))
+            return false;
+    }
+
+    if (!I.mayReadOrWriteMemory())
+        return true;
+
+    for (BasicBlock *BB : L1->blocks()) {
+        for (Instruction &LoopI : *BB) {
+            if (mayConflict(I, LoopI, DI))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Vero se scambiare l'ordine tra I0 e I1 può cambiare il risultato
+bool mayConflict(Instruction &I0, Instruction &I1, DependenceInfo &DI) {
+    if (!I0.mayReadOrWriteMemory() || !I1.mayReadOrWriteMemory())
+        return false;
+    if (!I0.mayWriteToMemory() && !I1.mayWriteToMemory())
+        return false;
+    return DI.depends(&I0, &I1, true) != nullptr;
+}
+
+void moveInterveningCode(Loop *L0, Loop *L1, ArrayRef<Instruction *> ToHoist,
+                         ArrayRef<Instruction *> ToSink) {
+    // L'ordine relativo delle istruzioni spostate nello stesso punto resta
+    // quello originale
+    Instruction *HoistPt = L0->getLoopPreheader()->getTerminator();
+    for (Instruction *I : ToHoist) {
+        errs() << "Hoisting intervening instruction above Loop 0: " << *I << "\n";
+        I->moveBefore(HoistPt);
+    }
+
+    BasicBlock *Exit1 = L1->getExitBlock();
+    Instruction *SinkPt = &*Exit1->getFirstInsertionPt();
+    for (Instruction *I : ToSink) {
+        errs() << "Sinking intervening instruction below Loop 1: " << *I << "\n";
+        I->moveBefore(SinkPt);
+    }
+}
+
 bool areControlFlowEquivalent(Loop *L0, Loop *L1, DominatorTree &DT, PostDominatorTree &PDT) {
     BasicBlock *H0 = L0->getHeader();
     BasicBlock *H1 = L1->getHeader();
@@ -162,48 +776,684 @@ bool areControlFlowEquivalent(Loop *L0, Loop *L1, DominatorTree &DT, PostDominat
     return false;
 }
 
-bool equalTripCount(Loop *L0, Loop *L1, ScalarEvolution &SE) {
-    // Controlla se i loop hanno lo stesso trip count
-    // auto TC0 = SE.getSmallConstantTripCount(L0);
-    // auto TC1 = SE.getSmallConstantTripCount(L1);
+const SCEV *getTripCount(Loop *L, ScalarEvolution &SE) {
+    const SCEV *ExitCount = SE.getExitCount(L, L->getExitingBlock());
+    if (isa<SCEVCouldNotCompute>(ExitCount))
+        return nullptr;
+    return SE.getTripCountFromExitCount(ExitCount);
+}
+
+// Differenza TC0 - TC1 tra i trip count, se è una costante
+std::optional<int64_t> getTripCountDifference(Loop *L0, Loop *L1, ScalarEvolution &SE) {
+    const SCEV *TC0 = getTripCount(L0, SE);
+    const SCEV *TC1 = getTripCount(L1, SE);
+    if (!TC0 || !TC1 || TC0->getType() != TC1->getType()) {
+        errs() << "Trip counts cannot be compared, loops cannot be fused\n";
+        return std::nullopt;
+    }
+
+    errs() << "Trip count for Loop 0: " << *TC0 << "\n";
+    errs() << "Trip count for Loop 1: " << *TC1 << "\n";
+
+    auto *Diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(TC0, TC1));
+    if (!Diff) {
+        errs() << "Trip counts do not differ by a constant, loops cannot be fused\n";
+        return std::nullopt;
+    }
+    return Diff->getAPInt().getSExtValue();
+}
+
+bool canPeel(Loop *L, int64_t Count) {
+    if (Count > MaxPeelCount) {
+        errs() << "Too many iterations to peel (" << Count << ")\n";
+        return false;
+    }
+    if (PeeledLoops.count(L)) {
+        errs() << "Loop was already peeled\n";
+        return false;
+    }
+    return true;
+}
+
+// Modello di costo: la fusione elimina il controllo di un loop e fa
+// rileggere dalla cache i dati già toccati dal primo loop, ma il corpo fuso
+// tiene vivi più valori (rischio di spill) e apre più flussi di memoria
+// (rischio di perdere il prefetch). Si fonde solo se c'è riuso e supera
+// i costi: due loop senza dati in comune non guadagnano nulla.
+bool isFusionProfitable(Loop *L0, Loop *L1, ScalarEvolution &SE) {
+    unsigned Reuse = countReusedAccesses(L0, L1, SE);
 
-    auto TC0 = SE.getTripCountFromExitCount(SE.getExitCount(L0, L0->getExitingBlock()));
-    auto TC1 = SE.getTripCountFromExitCount(SE.getExitCount(L1, L1->getExitingBlock()));
+    // Registri: PHI degli header (l'IV di L1 sparisce) e valori definiti
+    // fuori dai loop ma usati dentro, vivi per tutto il loop fuso
+    SmallPtrSet<Value *, 16> LiveIn;
+    unsigned PHIs0 = collectLiveIns(L0, LiveIn);
+    unsigned PHIs1 = collectLiveIns(L1, LiveIn);
+    unsigned Pressure = PHIs0 + PHIs1 - 1 + LiveIn.size();
+    unsigned NumRegs = TTI->getNumberOfRegisters(TTI->getRegisterClassForType(false));
+    unsigned SpilledRegs = Pressure > NumRegs ? Pressure - NumRegs : 0;
 
-    errs() << "Trip count for Loop 0: " << (&TC0) << "\n";
-    errs() << "Trip count for Loop 1: " << (&TC1) << "\n";
+    // Flussi: un flusso per oggetto in memoria con indirizzo che avanza
+    SmallPtrSet<const Value *, 16> Streams;
+    collectStreams(L0, SE, Streams);
+    collectStreams(L1, SE, Streams);
+    unsigned ExtraStreams = Streams.size() > MaxMemoryStreams ? Streams.size() - MaxMemoryStreams : 0;
 
-    if (TC0 && TC1 && TC0 == TC1) {
+    int Score = (int)Reuse - (int)SpilledRegs - (int)ExtraStreams;
+    errs() << "Fusion cost model: reuse " << Reuse << ", register pressure " << Pressure << "/"
+           << NumRegs << ", streams " << Streams.size() << ", score " << Score << "\n";
+
+    if (Reuse > 0 && Score > 0) {
+        ORE->emit([&]() {
+            return OptimizationRemarkAnalysis(DEBUG_TYPE, "Profitable", L0->getStartLoc(), L0->getHeader())
+                   << "fusion is profitable: " << ore::NV("ReusedAccesses", Reuse)
+                   << " reused accesses, " << ore::NV("RegisterPressure", Pressure)
+                   << " live values for " << ore::NV("Registers", NumRegs) << " registers, "
+                   << ore::NV("Streams", (unsigned)Streams.size()) << " memory streams";
+        });
         return true;
-    } else {
-        errs() << "Trip counts are not equal, loops cannot be fused\n";
     }
+
+    ORE->emit([&]() {
+        return OptimizationRemarkMissed(DEBUG_TYPE, "NotProfitable", L0->getStartLoc(), L0->getHeader())
+               << "fusion is not profitable: " << ore::NV("ReusedAccesses", Reuse)
+               << " reused accesses do not pay for " << ore::NV("SpilledRegisters", SpilledRegs)
+               << " spilled registers and " << ore::NV("ExtraStreams", ExtraStreams)
+               << " memory streams beyond the prefetcher limit";
+    });
     return false;
 }
 
-bool controlDependencies(Loop *L0, Loop *L1, DependenceInfo &DI) {
-    // Controlla le dipendenze tra tutte le istruzioni dei due loop
-    for (BasicBlock *BB0 : L0->blocks()) {
-        for (Instruction &I0 : *BB0) {
-            for (BasicBlock *BB1 : L1->blocks()) {
-                for (Instruction &I1 : *BB1) {
-                    if (auto D = DI.depends(&I0, &I1, true)) {
-                        if (D->isConfused() || D->isOrdered()) {
-                            errs() << "Found problematic dependency:\n";
-                            I0.print(errs());
-                            errs() << "\n  and\n";
-                            I1.print(errs());
-                            errs() << "\n";
-                            return false;
-                        }
-                    }
+// Accessi di L1 che toccano dati già toccati da L0 abbastanza di recente da
+// essere ancora in cache nel loop fuso
+unsigned countReusedAccesses(Loop *L0, Loop *L1, ScalarEvolution &SE) {
+    int64_t ReuseDistance = DefaultReuseDistance;
+    if (std::optional<unsigned> CacheSize = TTI->getCacheSize(TargetTransformInfo::CacheLevel::L1D))
+        ReuseDistance = *CacheSize;
+
+    MemoryGroups &Groups0 = getMemoryGroups(L0);
+    unsigned Reuse = 0;
+    for (auto &G1 : getMemoryGroups(L1)) {
+        auto G0 = Groups0.find(G1.first);
+        if (!G1.first || G0 == Groups0.end())
+            continue;
+        for (Instruction *I1 : G1.second) {
+            for (Instruction *I0 : G0->second) {
+                if (isReusedWithin(I0, I1, L0, L1, ReuseDistance, SE)) {
+                    ++Reuse;
+                    break;
                 }
             }
         }
     }
+    return Reuse;
+}
+
+bool isReusedWithin(Instruction *I0, Instruction *I1, Loop *L0, Loop *L1, int64_t ReuseDistance,
+                    ScalarEvolution &SE) {
+    std::optional<AccessFootprint> F0 = getAccessFootprint(I0, L0, SE);
+    std::optional<AccessFootprint> F1 = getAccessFootprint(I1, L1, SE);
+    if (!F0 || !F1 ||
+        F0->AR->getStepRecurrence(SE) != F1->AR->getStepRecurrence(SE))
+        return false;
+
+    // Stesso passo: nel loop fuso i due accessi restano a distanza costante
+    auto *Diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(F1->AR->getStart(), F0->AR->getStart()));
+    if (!Diff)
+        return false;
+    int64_t Delta = Diff->getAPInt().getSExtValue();
+    return std::abs(Delta) + std::max(F0->Hi - F0->Lo, F1->Hi - F1->Lo) <= ReuseDistance;
+}
+
+// Aggiunge a LiveIn i valori definiti fuori da L e usati dentro, e
+// restituisce il numero di PHI nell'header di L
+unsigned collectLiveIns(Loop *L, SmallPtrSetImpl<Value *> &LiveIn) {
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            for (Value *Op : I.operands()) {
+                if (isa<Argument>(Op) ||
+                    (isa<Instruction>(Op) && !L->contains(cast<Instruction>(Op)->getParent())))
+                    LiveIn.insert(Op);
+            }
+        }
+    }
+    return std::distance(L->getHeader()->phis().begin(), L->getHeader()->phis().end());
+}
+
+void collectStreams(Loop *L, ScalarEvolution &SE, SmallPtrSetImpl<const Value *> &Streams) {
+    for (auto &G : getMemoryGroups(L)) {
+        if (!G.first)
+            continue;
+        for (Instruction *I : G.second) {
+            Value *Ptr = getLoadStorePointerOperand(I);
+            if (Ptr && !SE.isLoopInvariant(SE.getSCEV(Ptr), L)) {
+                Streams.insert(G.first);
+                break;
+            }
+        }
+    }
+}
+
+bool canGuardTripCounts(Loop *L0, Loop *L1, const SCEV *TC0, const SCEV *TC1,
+                        Instruction *ExpandPt, SCEVExpander &Expander) {
+    if (SlowPathLoops.count(L0) || SlowPathLoops.count(L1)) {
+        errs() << "Loops belong to the unfused version of a runtime check\n";
+        return false;
+    }
+    // Il controllo sostituisce il preheader di L0, che deve portare
+    // direttamente all'header
+    if (L0->isGuarded()) {
+        errs() << "Loop 0 is guarded, runtime trip count check not emitted\n";
+        return false;
+    }
+    if (!TC0 || !TC1 || TC0->getType() != TC1->getType() ||
+        !Expander.isSafeToExpandAt(TC0, ExpandPt) || !Expander.isSafeToExpandAt(TC1, ExpandPt)) {
+        errs() << "Trip counts cannot be computed before Loop 0\n";
+        return false;
+    }
     return true;
 }
 
+// Duplica la sequenza L0, preheader di L1, L1: il preheader di L0 controlla
+// a runtime TC0 == TC1 e sceglie la sequenza originale, che verrà fusa, o la
+// copia, che resta com'è. Le due versioni si riuniscono nell'uscita di L1.
+void guardTripCounts(Loop *L0, Loop *L1, Value *TC0, Value *TC1, LoopInfo &LI,
+                     DomTreeUpdater &DTU) {
+    BasicBlock *Preheader0 = L0->getLoopPreheader();
+    BasicBlock *Header0 = L0->getHeader();
+    BasicBlock *Preheader1 = L1->getLoopPreheader();
+    BasicBlock *Header1 = L1->getHeader();
+    BasicBlock *Exit1 = L1->getExitBlock();
+    Function *F = Header0->getParent();
+
+    // 1. Copia della sequenza, inserita prima dell'uscita di L1
+    SmallVector<BasicBlock *, 16> Region(L0->blocks().begin(), L0->blocks().end());
+    Region.push_back(Preheader1);
+    Region.append(L1->blocks().begin(), L1->blocks().end());
+
+    ValueToValueMapTy VMap;
+    SmallVector<BasicBlock *, 16> NewBlocks;
+    for (BasicBlock *BB : Region) {
+        BasicBlock *NewBB = CloneBasicBlock(BB, VMap, ".slow", F);
+        NewBB->moveBefore(Exit1);
+        VMap[BB] = NewBB;
+        NewBlocks.push_back(NewBB);
+    }
+    remapInstructionsInBlocks(NewBlocks, VMap);
+    BasicBlock *NewHeader0 = cast<BasicBlock>(VMap[Header0]);
+    BasicBlock *NewHeader1 = cast<BasicBlock>(VMap[Header1]);
+
+    // 2. Il preheader di L0 sceglie la versione
+    BasicBlock *FusedPreheader = BasicBlock::Create(F->getContext(), Header0->getName() + ".fused.ph", F, Header0);
+    BasicBlock *SlowPreheader = BasicBlock::Create(F->getContext(), Header0->getName() + ".slow.ph", F, NewHeader0);
+    BranchInst::Create(Header0, FusedPreheader);
+    BranchInst::Create(NewHeader0, SlowPreheader);
+    Header0->replacePhiUsesWith(Preheader0, FusedPreheader);
+    NewHeader0->replacePhiUsesWith(Preheader0, SlowPreheader);
+
+    Instruction *Term = Preheader0->getTerminator();
+    Value *Check = new ICmpInst(Term, ICmpInst::ICMP_EQ, TC0, TC1, "tc.check");
+    BranchInst::Create(FusedPreheader, SlowPreheader, Check, Term);
+    Term->eraseFromParent();
+
+    SmallVector<DominatorTree::UpdateType, 32> Updates;
+    NewBlocks.push_back(FusedPreheader);
+    NewBlocks.push_back(SlowPreheader);
+    addSuccessorEdges(NewBlocks, Updates);
+    Updates.push_back({DominatorTree::Delete, Preheader0, Header0});
+    Updates.push_back({DominatorTree::Insert, Preheader0, FusedPreheader});
+    Updates.push_back({DominatorTree::Insert, Preheader0, SlowPreheader});
+    DTU.applyUpdates(Updates);
+
+    // 3. Nell'uscita di L1 i valori delle due versioni si uniscono con PHI
+    for (PHINode &PN : Exit1->phis()) {
+        Value *V = PN.getIncomingValueForBlock(Header1);
+        Value *NewV = VMap.lookup(V);
+        PN.addIncoming(NewV ? NewV : V, NewHeader1);
+    }
+
+    SmallPtrSet<BasicBlock *, 16> Cloned(Region.begin(), Region.end());
+    Cloned.insert(NewBlocks.begin(), NewBlocks.end());
+    for (BasicBlock *BB : Region) {
+        for (Instruction &I : *BB) {
+            SmallVector<Use *, 4> OutsideUses;
+            for (Use &U : I.uses()) {
+                auto *User = cast<Instruction>(U.getUser());
+                if (Cloned.count(User->getParent()))
+                    continue;
+                // Le PHI già presenti nell'uscita sono state completate sopra
+                if (isa<PHINode>(User) && User->getParent() == Exit1)
+                    continue;
+                OutsideUses.push_back(&U);
+            }
+            if (OutsideUses.empty())
+                continue;
+
+            PHINode *Merge = PHINode::Create(I.getType(), 2, I.getName() + ".merge", &Exit1->front());
+            Merge->addIncoming(&I, Header1);
+            Merge->addIncoming(VMap[&I], NewHeader1);
+            for (Use *U : OutsideUses)
+                U->set(Merge);
+        }
+    }
+
+    // 4. Le copie sono nuovi loop fratelli degli originali
+    SlowPathLoops.insert(addClonedLoop(L0, VMap, LI));
+    SlowPathLoops.insert(addClonedLoop(L1, VMap, LI));
+    if (Loop *Parent = L0->getParentLoop()) {
+        Parent->addBasicBlockToLoop(FusedPreheader, LI);
+        Parent->addBasicBlockToLoop(SlowPreheader, LI);
+        Parent->addBasicBlockToLoop(cast<BasicBlock>(VMap[Preheader1]), LI);
+    }
+}
+
+// Archi uscenti dai blocchi appena creati, da aggiungere agli alberi dei
+// dominatori
+void addSuccessorEdges(ArrayRef<BasicBlock *> Blocks, SmallVectorImpl<DominatorTree::UpdateType> &Updates) {
+    for (BasicBlock *BB : Blocks) {
+        SmallPtrSet<BasicBlock *, 4> Seen;
+        for (BasicBlock *Succ : successors(BB))
+            if (Seen.insert(Succ).second)
+                Updates.push_back({DominatorTree::Insert, BB, Succ});
+    }
+}
+
+// Registra in LoopInfo la copia di Orig ottenuta con VMap, come fratello di
+// Orig
+Loop *addClonedLoop(Loop *Orig, ValueToValueMapTy &VMap, LoopInfo &LI) {
+    Loop *NewLoop = LI.AllocateLoop();
+    if (Loop *Parent = Orig->getParentLoop())
+        Parent->addChildLoop(NewLoop);
+    else
+        LI.addTopLevelLoop(NewLoop);
+
+    // L'header va aggiunto per primo
+    NewLoop->addBasicBlockToLoop(cast<BasicBlock>(VMap[Orig->getHeader()]), LI);
+    for (BasicBlock *BB : Orig->blocks()) {
+        if (BB != Orig->getHeader())
+            NewLoop->addBasicBlockToLoop(cast<BasicBlock>(VMap[BB]), LI);
+    }
+    addClonedSubLoops(Orig, NewLoop, VMap, LI);
+    return NewLoop;
+}
+
+// Ricostruisce sotto NewParent i loop interni di Orig: i blocchi sono già
+// nei loop esterni, basta spostarli nel loop più interno che li contiene
+void addClonedSubLoops(Loop *Orig, Loop *NewParent, ValueToValueMapTy &VMap, LoopInfo &LI) {
+    for (Loop *Sub : *Orig) {
+        Loop *NewSub = LI.AllocateLoop();
+        NewParent->addChildLoop(NewSub);
+        for (BasicBlock *BB : Sub->blocks()) {
+            BasicBlock *NewBB = cast<BasicBlock>(VMap[BB]);
+            NewSub->addBlockEntry(NewBB);
+            if (LI.getLoopFor(BB) == Sub)
+                LI.changeLoopFor(NewBB, NewSub);
+        }
+        addClonedSubLoops(Sub, NewSub, VMap, LI);
+    }
+}
+
+// Relazione tra le variabili di induzione nella stessa iterazione del loop
+// fuso, quando L0 è avanti di Offset iterazioni:
+// IV1 = (IV0 * Scale + Offset) / Divisor, con divisione esatta
+struct IVRewrite {
+    int64_t Scale;
+    int64_t Offset;
+    int64_t Divisor;
+};
+
+std::optional<IVRewrite> getIVRewrite(Loop *L0, Loop *L1, int64_t Offset, ScalarEvolution &SE) {
+    PHINode *IV0 = getInductionVariable(L0, SE);
+    PHINode *IV1 = getInductionVariable(L1, SE);
+    if (!IV0 || !IV1 || IV0->getType() != IV1->getType() || !IV0->getType()->isIntegerTy()) {
+        errs() << "Induction variables not found or of different types\n";
+        return std::nullopt;
+    }
+    Type *Ty = IV0->getType();
+
+    auto *AR0 = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(IV0));
+    auto *AR1 = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(IV1));
+    if (!AR0 || !AR1 || AR0->getLoop() != L0 || AR1->getLoop() != L1 ||
+        !AR0->isAffine() || !AR1->isAffine()) {
+        errs() << "Induction variables are not affine recurrences\n";
+        return std::nullopt;
+    }
+
+    // Con passi diversi uno deve essere multiplo dell'altro: i valori di IV1
+    // si ottengono scalando quelli di IV0 o dividendoli senza resto
+    const SCEV *Step0 = AR0->getStepRecurrence(SE);
+    const SCEV *Step1 = AR1->getStepRecurrence(SE);
+    int64_t Scale = 1, Divisor = 1;
+    if (Step0 != Step1) {
+        auto *C0 = dyn_cast<SCEVConstant>(Step0);
+        auto *C1 = dyn_cast<SCEVConstant>(Step1);
+        if (!C0 || !C1 || C0->isZero() || C1->isZero()) {
+            errs() << "Induction variables have different non constant steps\n";
+            return std::nullopt;
+        }
+        int64_t S0 = C0->getAPInt().getSExtValue();
+        int64_t S1 = C1->getAPInt().getSExtValue();
+        if (S1 % S0 == 0) {
+            Scale = S1 / S0;
+        } else if (S0 % S1 == 0) {
+            // La divisione lavora sul valore di IV0: non deve andare in overflow
+            if (!AR0->hasNoSignedWrap()) {
+                errs() << "Induction variable of Loop 0 may wrap\n";
+                return std::nullopt;
+            }
+            Divisor = S0 / S1;
+        } else {
+            errs() << "Induction variable steps are not multiples of each other\n";
+            return std::nullopt;
+        }
+    }
+
+    // IV1 - Start1 = (IV0 - Start0) * Scale / Divisor, con Start0 il valore
+    // di IV0 nella prima iterazione fusa: resta costante solo
+    // Start1 * Divisor - Start0 * Scale
+    const SCEV *Start0 = SE.getAddExpr(AR0->getStart(),
+                                       SE.getMulExpr(SE.getConstant(Ty, Offset), Step0));
+    auto *Delta = dyn_cast<SCEVConstant>(
+        SE.getMinusSCEV(SE.getMulExpr(AR1->getStart(), SE.getConstant(Ty, Divisor)),
+                        SE.getMulExpr(Start0, SE.getConstant(Ty, Scale))));
+    if (!Delta) {
+        errs() << "Induction variables are not affinely related\n";
+        return std::nullopt;
+    }
+    return IVRewrite{Scale, Delta->getAPInt().getSExtValue(), Divisor};
+}
+
+// Divide L in due loop consecutivi: L esegue al più le prime FirstCount
+// iterazioni, una sua copia (restituita) esegue le restanti partendo dai
+// valori che le PHI dell'header hanno all'uscita di L.
+Loop *splitLoop(Loop *L, Value *FirstCount, LoopInfo &LI, DomTreeUpdater &DTU,
+                ScalarEvolution &SE) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    BasicBlock *Exit = L->getExitBlock();
+    Function *F = Header->getParent();
+
+    SE.forgetLoop(L);
+
+    // 1. Copia dei blocchi del loop, inseriti prima dell'uscita
+    ValueToValueMapTy VMap;
+    SmallVector<BasicBlock *, 8> NewBlocks;
+    BasicBlock *NewPreheader = BasicBlock::Create(F->getContext(), Header->getName() + ".peel.ph", F, Exit);
+    for (BasicBlock *BB : L->blocks()) {
+        BasicBlock *NewBB = CloneBasicBlock(BB, VMap, ".peel", F);
+        NewBB->moveBefore(Exit);
+        VMap[BB] = NewBB;
+        NewBlocks.push_back(NewBB);
+    }
+    remapInstructionsInBlocks(NewBlocks, VMap);
+    BasicBlock *NewHeader = cast<BasicBlock>(VMap[Header]);
+
+    // 2. Gli usi fuori dal loop vedono i valori finali della copia
+    SmallPtrSet<BasicBlock *, 8> NewBlockSet(NewBlocks.begin(), NewBlocks.end());
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            for (Use &U : make_early_inc_range(I.uses())) {
+                BasicBlock *UseBB = cast<Instruction>(U.getUser())->getParent();
+                if (!L->contains(UseBB) && !NewBlockSet.count(UseBB))
+                    U.set(VMap[&I]);
+            }
+        }
+    }
+    Exit->replacePhiUsesWith(Header, NewHeader);
+
+    // 3. La copia parte dai valori delle PHI di L al momento dell'uscita
+    for (PHINode &PN : Header->phis()) {
+        auto *NewPN = cast<PHINode>(VMap[&PN]);
+        int Idx = NewPN->getBasicBlockIndex(Preheader);
+        NewPN->setIncomingBlock(Idx, NewPreheader);
+        NewPN->setIncomingValue(Idx, &PN);
+    }
+    BranchInst::Create(NewHeader, NewPreheader);
+    Header->getTerminator()->replaceUsesOfWith(Exit, NewPreheader);
+
+    SmallVector<DominatorTree::UpdateType, 16> Updates;
+    NewBlocks.push_back(NewPreheader);
+    addSuccessorEdges(NewBlocks, Updates);
+    Updates.push_back({DominatorTree::Delete, Header, Exit});
+    Updates.push_back({DominatorTree::Insert, Header, NewPreheader});
+    DTU.applyUpdates(Updates);
+
+    // 4. Un contatore limita L a FirstCount iterazioni
+    Type *CountTy = FirstCount->getType();
+    PHINode *Counter = PHINode::Create(CountTy, 2, "peel.count", Header->getFirstNonPHI());
+    Instruction *Next = BinaryOperator::CreateNUWAdd(Counter, ConstantInt::get(CountTy, 1),
+                                                      "peel.count.next", Latch->getTerminator());
+    Counter->addIncoming(ConstantInt::get(CountTy, 0), Preheader);
+    Counter->addIncoming(Next, Latch);
+
+    auto *BI = cast<BranchInst>(Header->getTerminator());
+    Value *InRange = new ICmpInst(BI, ICmpInst::ICMP_ULT, Counter, FirstCount, "peel.cond");
+    BI->setCondition(BinaryOperator::CreateAnd(BI->getCondition(), InRange, "peel.and", BI));
+
+    // 5. La copia è un nuovo loop fratello di L
+    Loop *NewLoop = addClonedLoop(L, VMap, LI);
+    if (Loop *Parent = L->getParentLoop())
+        Parent->addBasicBlockToLoop(NewPreheader, LI);
+
+    PeeledLoops.insert(L);
+    PeeledLoops.insert(NewLoop);
+    return NewLoop;
+}
+
+// Raggruppa gli accessi in memoria del loop per oggetto sottostante. Le
+// istruzioni senza puntatore (es. chiamate) finiscono nel gruppo nullptr,
+// che può dipendere da qualsiasi altro accesso.
+MemoryGroups &getMemoryGroups(Loop *L) {
+    auto It = MemoryAccesses.find(L);
+    if (It != MemoryAccesses.end())
+        return It->second;
+
+    MemoryGroups &Groups = MemoryAccesses[L];
+    for (BasicBlock *BB : L->blocks()) {
+        for (Instruction &I : *BB) {
+            if (!I.mayReadOrWriteMemory())
+                continue;
+            const Value *Object = nullptr;
+            if (Value *Ptr = getLoadStorePointerOperand(&I))
+                Object = getUnderlyingObject(Ptr);
+            Groups[Object].push_back(&I);
+        }
+    }
+    return Groups;
+}
+
+// Dopo una trasformazione i risultati sul loop non sono più validi
+void invalidateLoopCaches(Loop *L) {
+    MemoryAccesses.erase(L);
+    for (auto It = DependenceCache.begin(); It != DependenceCache.end();) {
+        auto Cur = It++;
+        if (Cur->first.first == L || Cur->first.second == L)
+            DependenceCache.erase(Cur);
+    }
+}
+
+// Offset è il numero di iterazioni di cui L0 è avanti rispetto a L1 nel
+// loop fuso (dopo il peeling in testa di L0): nell'iterazione fusa t si
+// eseguono l'iterazione t + Offset di L0 e la t di L1.
+bool controlDependencies(Loop *L0, Loop *L1, DependenceInfo &DI, AAResults &AA,
+                         ScalarEvolution &SE, int64_t Offset) {
+    auto Key = std::make_pair(L0, L1);
+    auto Cached = DependenceCache.find(Key);
+    std::optional<int64_t> MinDistance;
+    if (Cached != DependenceCache.end()) {
+        errs() << "Using cached dependence result\n";
+        MinDistance = Cached->second;
+    } else {
+        MinDistance = computeDependences(L0, L1, DI, AA, SE);
+        DependenceCache[Key] = MinDistance;
+    }
+
+    if (!MinDistance)
+        return false;
+    // Un'iterazione i di L1 che dipende dall'iterazione j di L0 deve venire
+    // eseguita dopo di essa: i >= j - Offset
+    if (*MinDistance < -Offset) {
+        errs() << "Dependence distance " << *MinDistance << " is not allowed with offset "
+               << Offset << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Restituisce la distanza minima tra le dipendenze di L1 da L0 al livello
+// della fusione (il massimo di int64_t se non ce ne sono), o std::nullopt se
+// qualche dipendenza non è analizzabile.
+std::optional<int64_t> computeDependences(Loop *L0, Loop *L1, DependenceInfo &DI, AAResults &AA,
+                                          ScalarEvolution &SE) {
+    MemoryGroups &Groups0 = getMemoryGroups(L0);
+    MemoryGroups &Groups1 = getMemoryGroups(L1);
+    int64_t MinDistance = std::numeric_limits<int64_t>::max();
+
+    // Controlla le dipendenze solo tra accessi in memoria che possono
+    // riferirsi allo stesso oggetto
+    for (auto &G0 : Groups0) {
+        for (auto &G1 : Groups1) {
+            if (G0.first && G1.first && G0.first != G1.first &&
+                AA.isNoAlias(MemoryLocation::getBeforeOrAfter(G0.first),
+                             MemoryLocation::getBeforeOrAfter(G1.first)))
+                continue;
+
+            for (Instruction *I0 : G0.second) {
+                for (Instruction *I1 : G1.second) {
+                    // Due letture non creano dipendenze
+                    if (!I0->mayWriteToMemory() && !I1->mayWriteToMemory())
+                        continue;
+                    auto D = DI.depends(I0, I1, true);
+                    if (!D)
+                        continue;
+                    std::optional<int64_t> Distance = getDependenceDistance(I0, I1, *D, L0, L1, SE);
+                    if (!Distance) {
+                        errs() << "Found problematic dependency:\n";
+                        I0->print(errs());
+                        errs() << "\n  and\n";
+                        I1->print(errs());
+                        errs() << "\n";
+                        return std::nullopt;
+                    }
+                    MinDistance = std::min(MinDistance, *Distance);
+                }
+            }
+        }
+    }
+    return MinDistance;
+}
+
+// Distanza i - j tra l'iterazione i di L1 e l'iterazione j di L0 coinvolte
+// nella dipendenza: nel loop fuso L1 deve arrivare dopo L0, quindi distanze
+// negative rendono la fusione illecita. Dipendenze in avanti o interne alla
+// stessa iterazione (a[i] = ...; ... = a[i]) sono lecite.
+std::optional<int64_t> getDependenceDistance(Instruction *I0, Instruction *I1, Dependence &D,
+                                             Loop *L0, Loop *L1, ScalarEvolution &SE) {
+    // Livelli comuni (loop esterni condivisi): se la direzione esclude '='
+    // la dipendenza è portata da un loop esterno e la fusione non la tocca
+    if (!D.isConfused()) {
+        for (unsigned Level = 1; Level <= D.getLevels(); ++Level) {
+            if (!(D.getDirection(Level) & Dependence::DVEntry::EQ)) {
+                errs() << "Dependence carried by outer level " << Level << "\n";
+                return std::numeric_limits<int64_t>::max();
+            }
+        }
+    }
+
+    // La distanza al livello della fusione non è tra i livelli di Dependence
+    // (i due loop non sono comuni): si ricava dalle SCEV degli indirizzi
+    std::optional<int64_t> MinDistance = getMinFusedDistance(I0, I1, L0, L1, SE);
+    if (!MinDistance) {
+        errs() << "Unknown dependence distance at the fused level\n";
+        return std::nullopt;
+    }
+    errs() << "Minimum dependence distance at the fused level: " << *MinDistance << "\n";
+    return MinDistance;
+}
+
+// Byte toccati da un accesso durante una iterazione di L, relativi al valore
+// che la ricorrenza AR dell'indirizzo su L ha in quella iterazione. Per gli
+// accessi nei loop interni a L l'intervallo [Lo, Hi) copre tutte le loro
+// iterazioni, limitate dal massimo numero di iterazioni di ciascun livello.
+struct AccessFootprint {
+    const SCEVAddRecExpr *AR;
+    int64_t Lo;
+    int64_t Hi;
+};
+
+std::optional<AccessFootprint> getAccessFootprint(Instruction *I, Loop *L, ScalarEvolution &SE) {
+    Value *Ptr = getLoadStorePointerOperand(I);
+    if (!Ptr)
+        return std::nullopt;
+
+    const DataLayout &DL = I->getModule()->getDataLayout();
+    int64_t Lo = 0;
+    int64_t Hi = DL.getTypeStoreSize(getLoadStoreType(I)).getFixedValue();
+
+    // Le ricorrenze dei loop interni precedono quella di L
+    const SCEV *S = SE.getSCEV(Ptr);
+    while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+        if (!AR->isAffine() || !L->contains(AR->getLoop()))
+            return std::nullopt;
+        if (AR->getLoop() == L)
+            return AccessFootprint{AR, Lo, Hi};
+
+        auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        auto *MaxBTC = dyn_cast<SCEVConstant>(SE.getConstantMaxBackedgeTakenCount(AR->getLoop()));
+        if (!Step || !MaxBTC)
+            return std::nullopt;
+        int64_t Span = Step->getAPInt().getSExtValue() * MaxBTC->getAPInt().getSExtValue();
+        if (Span < 0)
+            Lo += Span;
+        else
+            Hi += Span;
+        S = AR->getStart();
+    }
+    return std::nullopt;
+}
+
+// Restituisce la distanza minima i - j tra un'iterazione i di L1 e
+// un'iterazione j di L0 che accedono a byte in comune, o std::nullopt se gli
+// indirizzi non sono ricorrenze affini con passo costante. Se gli accessi
+// non si sovrappongono mai restituisce il massimo di int64_t.
+std::optional<int64_t> getMinFusedDistance(Instruction *I0, Instruction *I1, Loop *L0, Loop *L1,
+                                      ScalarEvolution &SE) {
+    std::optional<AccessFootprint> F0 = getAccessFootprint(I0, L0, SE);
+    std::optional<AccessFootprint> F1 = getAccessFootprint(I1, L1, SE);
+    if (!F0 || !F1)
+        return std::nullopt;
+
+    auto *Step0 = dyn_cast<SCEVConstant>(F0->AR->getStepRecurrence(SE));
+    auto *Step1 = dyn_cast<SCEVConstant>(F1->AR->getStepRecurrence(SE));
+    auto *Diff = dyn_cast<SCEVConstant>(SE.getMinusSCEV(F1->AR->getStart(), F0->AR->getStart()));
+    if (!Step0 || !Step1 || !Diff)
+        return std::nullopt;
+
+    int64_t Step = Step0->getAPInt().getSExtValue();
+    if (Step == 0 || Step != Step1->getAPInt().getSExtValue())
+        return std::nullopt;
+
+    // L'iterazione j di L0 e la i di L1 si sovrappongono se
+    // Lo < Step * (j - i) < Hi
+    int64_t Delta = Diff->getAPInt().getSExtValue();
+    int64_t Lo = Delta + F1->Lo - F0->Hi;
+    int64_t Hi = Delta + F1->Hi - F0->Lo;
+
+    // Con passo negativo si ragiona sul problema speculare
+    if (Step < 0) {
+        Step = -Step;
+        std::swap(Lo, Hi);
+        Lo = -Lo;
+        Hi = -Hi;
+    }
+
+    // Il più grande multiplo di Step strettamente minore di Hi
+    int64_t MaxK = (Hi > 0) ? (Hi - 1) / Step : -((-Hi) / Step) - 1;
+    if (Step * MaxK <= Lo)
+        return std::numeric_limits<int64_t>::max();
+    return -MaxK;
+}
+
 BasicBlock *resolveEffectivePreheader(BasicBlock *Exit, BasicBlock *L1Header) {
     // Se Exit ha un solo successore
     if (Exit->getTerminator()->getNumSuccessors() == 1) {
@@ -231,15 +1481,18 @@ BasicBlock *getBody(Loop *L) {
     return (dyn_cast<BranchInst>(L->getHeader()->getTerminator()))->getSuccessor(0);
 }
 
-bool fuseLoops(Loop *L0, Loop *L1, LoopInfo &LI) {
+bool fuseLoops(Loop *L0, Loop *L1, PHINode *IV0, PHINode *IV1, LoopInfo &LI, DomTreeUpdater &DTU,
+               const IVRewrite &Rewrite) {
     // Ottieni il body di L1 da inserire in L0
        BasicBlock* Body1 = getBody(L1);
 
-       // Il blocco di uscita di L1 è il blocco di ingresso di L0
-       BasicBlock* Exit0 = getEntryBlock(L0);
+       // Il blocco di uscita di L0 è il blocco di ingresso di L1
+       BasicBlock* Preheader0 = L0->getLoopPreheader();
+       BasicBlock* Exit0 = L0->getExitBlock();
        BasicBlock* Latch0 = L0->getLoopLatch();
        BasicBlock* Header0 = L0->getHeader();
 
+       BasicBlock* Preheader1 = L1->getLoopPreheader();
        BasicBlock* Exit1 = L1->getExitBlock();
        BasicBlock* Latch1 = L1->getLoopLatch();
        BasicBlock* Header1 = L1->getHeader();
@@ -251,11 +1504,8 @@ bool fuseLoops(Loop *L0, Loop *L1, LoopInfo &LI) {
 
     // 1. Modifica gli usi della variabile di induzione nel body del
     // loop 1 con quelli della variabile di induzione del loop 0
-    // Trova le IV (phi node) nei due header
     errs() << "Header0: " << *Header0 << "\n";
     errs() << "Header1: " << *Header1 << "\n";
-    PHINode *IV0 = dyn_cast<PHINode>(&Header0->front());
-    PHINode *IV1 = dyn_cast<PHINode>(&Header1->front());
     if (!IV0) {
        errs() << "Impossibile trovare la variabile di induzione L0\n";
        return false;
@@ -264,32 +1514,112 @@ bool fuseLoops(Loop *L0, Loop *L1, LoopInfo &LI) {
        errs() << "Impossibile trovare la variabile di induzione L1\n";
        return false;
     }
-    // Sostituisci tutti gli usi della variabile di induzione di L1 con quella di L0
-    IV1->replaceAllUsesWith(IV0);
+    // Sostituisci tutti gli usi della variabile di induzione di L1 con
+    // un'espressione di quella di L0, se i due loop partono da valori
+    // diversi o hanno passi diversi
+    Type *IVTy = IV0->getType();
+    Instruction *InsertPt = Header0->getFirstNonPHI();
+    Value *NewIV1 = IV0;
+    if (Rewrite.Scale != 1) {
+       NewIV1 = BinaryOperator::CreateMul(NewIV1, ConstantInt::get(IVTy, Rewrite.Scale, true),
+                                          "iv.scale", InsertPt);
+    }
+    if (Rewrite.Offset != 0) {
+       NewIV1 = BinaryOperator::CreateAdd(NewIV1, ConstantInt::get(IVTy, Rewrite.Offset, true),
+                                          "iv.shift", InsertPt);
+    }
+    if (Rewrite.Divisor != 1) {
+       NewIV1 = BinaryOperator::CreateExactSDiv(NewIV1, ConstantInt::get(IVTy, Rewrite.Divisor, true),
+                                                "iv.div", InsertPt);
+    }
+    IV1->replaceAllUsesWith(NewIV1);
 
-    // Collega il terminatore dell'header di L0 al body di L1
+    // 2. Le altre PHI di Header1 (riduzioni, ricorrenze) passano in Header0:
+    // il valore iniziale arriva dal preheader di L0, quello aggiornato dal
+    // latch di L0, in cui finiscono le istruzioni di Latch1. Gli usi dopo il
+    // loop, comprese le PHI LCSSA di Exit1, leggono la nuova PHI.
+    for (PHINode &PN : make_early_inc_range(Header1->phis())) {
+       if (&PN == IV1)
+          continue;
+       PHINode *Moved = PHINode::Create(PN.getType(), 2, "", Header0->getFirstNonPHI());
+       Moved->takeName(&PN);
+       Moved->addIncoming(PN.getIncomingValueForBlock(Preheader1), Preheader0);
+       Moved->addIncoming(PN.getIncomingValueForBlock(Latch1), Latch0);
+       PN.replaceAllUsesWith(Moved);
+    }
+    while (Latch1->size() > 1)
+       Latch1->front().moveBefore(Latch0->getTerminator());
+
+    // L'header di L0 esce direttamente nell'uscita di L1: preheader e header
+    // di L1 diventano irraggiungibili e il loop fuso ha un'unica uscita
     Header0->getTerminator()->replaceUsesOfWith(Exit0, Exit1);
+    Exit1->replacePhiUsesWith(Header1, Header0);
+    // Header1 non deve più comparire tra i predecessori di Exit1, altrimenti
+    // eliminarlo toglierebbe da Exit1 un arco che le PHI non hanno più
+    Header1->getTerminator()->eraseFromParent();
+    new UnreachableInst(Header1->getContext(), Header1);
 
     // I blocchi predecessori di Latch0 devono ora avere Body1 come successore
-    for (BasicBlock *Pred : predecessors(Latch0)) {
+    // (i predecessori vanno copiati: modificare i terminatori cambia la lista)
+    SmallVector<BasicBlock *, 4> Latch0Preds(predecessors(Latch0));
+    SmallVector<BasicBlock *, 4> Latch1Preds(predecessors(Latch1));
+    for (BasicBlock *Pred : Latch0Preds) {
        // Sostituisci il successore del predecessore con Body1
        Pred->getTerminator()->replaceUsesOfWith(Latch0, Body1);
     }
 
     // I blocchi predecessori di Latch1 devono ora avere Latch0 come successore
-    for (BasicBlock *Pred : predecessors(Latch1)) {
+    for (BasicBlock *Pred : Latch1Preds) {
        // Sostituisci il successore del predecessore con Latch0
        Pred->getTerminator()->replaceUsesOfWith(Latch1, Latch0);
     }
 
-    // Aggiungi i blocchi di L1 al loop di L0
-    for (BasicBlock *BB : L1->blocks()) {
-       if (BB != Header1 && BB != Latch1) {
-          L0->addBasicBlockToLoop(BB, LI);
-       }
+    // Gli archi di Header1 spariscono con il suo terminatore; i blocchi
+    // rimasti irraggiungibili vengono tolti dagli alberi quando si eliminano
+    SmallVector<DominatorTree::UpdateType, 16> Updates;
+    Updates.push_back({DominatorTree::Delete, Header0, Exit0});
+    Updates.push_back({DominatorTree::Insert, Header0, Exit1});
+    Updates.push_back({DominatorTree::Delete, Header1, Body1});
+    Updates.push_back({DominatorTree::Delete, Header1, Exit1});
+    for (BasicBlock *Pred : Latch0Preds) {
+       Updates.push_back({DominatorTree::Delete, Pred, Latch0});
+       Updates.push_back({DominatorTree::Insert, Pred, Body1});
+    }
+    for (BasicBlock *Pred : Latch1Preds) {
+       Updates.push_back({DominatorTree::Delete, Pred, Latch1});
+       Updates.push_back({DominatorTree::Insert, Pred, Latch0});
+    }
+    // Un predecessore con più archi verso il latch compare più volte
+    DTU.applyUpdatesPermissive(Updates);
+
+    // Preheader, header e latch di L1 sono ormai irraggiungibili: vanno tolti
+    // da LoopInfo (anche dai loop che contengono L0 e L1) prima di eliminarli
+    LI.removeBlock(Exit0);
+    LI.removeBlock(Header1);
+    LI.removeBlock(Latch1);
+
+    // Gli altri blocchi di L1 passano a L0; quelli dei loop interni restano
+    // nei loro loop, che diventano figli di L0
+    SmallVector<BasicBlock *, 8> Blocks1(L1->blocks());
+    for (BasicBlock *BB : Blocks1) {
+       L1->removeBlockFromLoop(BB);
+       L0->addBlockEntry(BB);
+       if (LI.getLoopFor(BB) == L1)
+          LI.changeLoopFor(BB, L0);
+    }
+    while (!L1->isInnermost()) {
+       Loop *Child = *L1->begin();
+       L1->removeChildLoop(L1->begin());
+       L0->addChildLoop(Child);
     }
 
     LI.erase(L1); // Elimina il loop L1 dalla LoopInfo
+
+    // Nei nest l'uscita del loop interno di L0 porta direttamente al
+    // preheader di quello di L1: unendo i due blocchi i loop interni
+    // diventano adiacenti e possono essere fusi a loro volta
+    if (!L0->isInnermost())
+       MergeBlockIntoPredecessor(Body1, &DTU, &LI);
     
     // Controlla che L1 non sia più presente nella LoopInfo
     for (auto &L : LI) {
@@ -303,6 +1633,85 @@ bool fuseLoops(Loop *L0, Loop *L1, LoopInfo &LI) {
     return true;
 }
 
+// Contrazione degli array temporanei: un array locale scritto e riletto
+// allo stesso indice nella stessa iterazione di un loop fuso non ha bisogno
+// della memoria, il valore scritto passa direttamente alle letture
+bool contractArrays(Function &F, LoopInfo &LI, DominatorTree &DT, ScalarEvolution &SE) {
+    // La contrazione elimina anche istruzioni dell'entry block
+    SmallVector<AllocaInst *, 8> Allocas;
+    for (Instruction &I : F.getEntryBlock())
+        if (auto *AI = dyn_cast<AllocaInst>(&I))
+            Allocas.push_back(AI);
+
+    bool Changed = false;
+    for (AllocaInst *AI : Allocas)
+        Changed |= contractArray(AI, LI, DT, SE);
+    return Changed;
+}
+
+bool contractArray(AllocaInst *AI, LoopInfo &LI, DominatorTree &DT, ScalarEvolution &SE) {
+    // L'array non deve uscire dalla funzione: solo GEP, letture, una
+    // scrittura e marcatori di lifetime
+    StoreInst *Store = nullptr;
+    SmallVector<LoadInst *, 4> Loads;
+    SmallVector<Instruction *, 8> Addresses;
+    SmallVector<Instruction *, 8> Worklist(1, AI);
+    while (!Worklist.empty()) {
+        Instruction *Ptr = Worklist.pop_back_val();
+        for (User *U : Ptr->users()) {
+            auto *UI = cast<Instruction>(U);
+            if (isa<GetElementPtrInst>(UI) || isa<BitCastInst>(UI)) {
+                Addresses.push_back(UI);
+                Worklist.push_back(UI);
+            } else if (auto *Load = dyn_cast<LoadInst>(UI)) {
+                if (!Load->isSimple())
+                    return false;
+                Loads.push_back(Load);
+            } else if (auto *SI = dyn_cast<StoreInst>(UI)) {
+                if (Store || !SI->isSimple() || SI->getValueOperand() == Ptr)
+                    return false;
+                Store = SI;
+            } else if (!UI->isLifetimeStartOrEnd()) {
+                return false;
+            }
+        }
+    }
+    if (!Store || Loads.empty())
+        return false;
+
+    Loop *L = LI.getLoopFor(Store->getParent());
+    if (!L || !FusedLoops.count(L))
+        return false;
+
+    // Ogni lettura avviene nella stessa iterazione della scrittura, dopo di
+    // essa e allo stesso indirizzo: legge sempre il valore appena scritto
+    const SCEV *StorePtr = SE.getSCEV(Store->getPointerOperand());
+    for (LoadInst *Load : Loads) {
+        if (LI.getLoopFor(Load->getParent()) != L || !DT.dominates(Store, Load) ||
+            SE.getSCEV(Load->getPointerOperand()) != StorePtr ||
+            Load->getType() != Store->getValueOperand()->getType())
+            return false;
+    }
+
+    errs() << "Contracting array " << AI->getName() << " in loop "
+           << L->getHeader()->getName() << "\n";
+    for (LoadInst *Load : Loads) {
+        Load->replaceAllUsesWith(Store->getValueOperand());
+        Load->eraseFromParent();
+    }
+    Store->eraseFromParent();
+    // Restano solo i calcoli degli indirizzi e i marcatori di lifetime
+    for (Instruction *Addr : reverse(Addresses)) {
+        for (User *U : make_early_inc_range(Addr->users()))
+            cast<Instruction>(U)->eraseFromParent();
+        Addr->eraseFromParent();
+    }
+    for (User *U : make_early_inc_range(AI->users()))
+        cast<Instruction>(U)->eraseFromParent();
+    AI->eraseFromParent();
+    return true;
+}
+
   static bool isRequired() { return true; }
 
 };
@@ -325,6 +1734,23 @@ llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
                     // FPM.addPass(LoopRotatePass());
                     return true;
                   }
+                  // Fonde anche loop con trip count simbolici diversi,
+                  // controllando a runtime che coincidano
+                  if (Name == "loop_fusion_runtime") {
+                    FPM.addPass(TestPass(/*RuntimeTripCountCheck=*/true));
+                    FPM.addPass(LoopSimplifyPass());
+                    return true;
+                  }
+                  // Unroll-and-jam dei nest, con fattore 4 o quello indicato
+                  // in unroll_and_jam<N>
+                  unsigned Factor = DefaultUnrollAndJamFactor;
+                  if (Name == "unroll_and_jam" ||
+                      (Name.consume_front("unroll_and_jam<") && Name.consume_back(">") &&
+                       !Name.getAsInteger(10, Factor) && Factor > 1)) {
+                    FPM.addPass(TestPass(/*RuntimeTripCountCheck=*/false, Factor));
+                    FPM.addPass(LoopSimplifyPass());
+                    return true;
+                  }
                   return false;
                 });
           }};
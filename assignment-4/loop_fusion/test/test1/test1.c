@@ -10,7 +10,7 @@ void test_adjacent() {
     }
 
     int c=50;
-    c++
+    c++;
 
     // Secondo loop (adiacente)
     for (j = 0; j < 10; j++) {
@@ -0,0 +1,18 @@
+void test_intervening(int *out, int *count) {
+    int A[10], B[10];
+
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+    }
+
+    // Istruzioni tra i due loop: l'aggiornamento di count non tocca i loop
+    // e sale prima del primo, la lettura di A[7] dipende dal primo loop e
+    // scende dopo il secondo
+    *count = 2;
+    int last = A[7];
+
+    for (int i = 0; i < 10; i++) {
+        B[i] = A[i] * 3;
+    }
+    out[0] = B[5] + last;
+}
@@ -0,0 +1,29 @@
+// Da eseguire con -pass-remarks-analysis=loop-fusion e
+// -pass-remarks-missed=loop-fusion per vedere le decisioni del modello di costo
+void test_reuse(int *out) {
+    int A[10], B[10];
+
+    // Il secondo loop rilegge A: la fusione conviene
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+    }
+    for (int i = 0; i < 10; i++) {
+        B[i] = A[i] * 3;
+    }
+    out[0] = B[5];
+}
+
+void test_pressure(int *out, int x0, int x1, int x2, int x3, int x4, int x5,
+                   int x6, int x7, int x8, int x9, int x10, int x11) {
+    int A[10], B[10];
+
+    // Nessun dato in comune: senza riuso la fusione non conviene, anche se i
+    // 15 valori vivi nel corpo fuso starebbero nei registri
+    for (int i = 0; i < 10; i++) {
+        A[i] = i + x0 + x1 + x2 + x3 + x4 + x5;
+    }
+    for (int i = 0; i < 10; i++) {
+        B[i] = i + x6 + x7 + x8 + x9 + x10 + x11;
+    }
+    out[0] = A[5] + B[5];
+}
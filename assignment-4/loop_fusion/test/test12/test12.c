@@ -0,0 +1,33 @@
+int test_reductions() {
+    int A[10];
+    int sum = 0, max = 0, prev = -1, total = 0;
+
+    // Le riduzioni del secondo loop passano nell'header del loop fuso
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+        sum += i;
+    }
+    for (int i = 0; i < 10; i++) {
+        total += A[i] * 3;
+        if (A[i] > max)
+            max = A[i];
+        prev = A[i];
+    }
+    return sum + total + max + prev;
+}
+
+int test_scalar_dependence() {
+    int A[10];
+    int sum = 0;
+
+    // Il secondo loop parte dal valore finale di sum: non si fondono
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+        sum += i;
+    }
+    int total = sum;
+    for (int i = 0; i < 10; i++) {
+        total += A[i];
+    }
+    return total;
+}
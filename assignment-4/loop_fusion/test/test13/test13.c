@@ -0,0 +1,41 @@
+int test_scaled_iv() {
+    int A[23];
+    int sum = 0;
+
+    // j = 2 * i + 3: gli usi di j diventano un'espressione di i
+    for (int i = 0; i < 10; i++) {
+        A[2 * i + 3] = i;
+    }
+    for (int j = 3; j < 23; j += 2) {
+        sum += j * j + A[j];
+    }
+    return sum + A[5];
+}
+
+int test_divided_iv() {
+    int A[20];
+    int sum = 0;
+
+    // j = i / 2 + 1, con divisione esatta
+    for (int i = 0; i < 20; i += 2) {
+        A[i] = i;
+    }
+    for (int j = 1; j < 11; j++) {
+        sum += A[2 * j - 2] * 3;
+    }
+    return sum + A[4];
+}
+
+int test_unrelated_steps() {
+    int A[20];
+    int sum = 0;
+
+    // Passi 2 e 3: nessuno è multiplo dell'altro, i loop non si fondono
+    for (int i = 0; i < 20; i += 2) {
+        A[i] = i;
+    }
+    for (int j = 0; j < 30; j += 3) {
+        sum += j;
+    }
+    return sum + A[4];
+}
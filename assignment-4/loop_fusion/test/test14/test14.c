@@ -0,0 +1,40 @@
+// in e out sono restrict: senza, potrebbero puntare alla stessa memoria e
+// la dipendenza tra i due loop non si potrebbe verificare
+void test_contraction(const int *restrict in, int *restrict out) {
+    int tmp[10];
+
+    // Dopo la fusione tmp[i] viene scritto e riletto nella stessa
+    // iterazione: l'array diventa un valore scalare e sparisce
+    for (int i = 0; i < 10; i++) {
+        tmp[i] = in[i] * 5;
+    }
+    for (int i = 0; i < 10; i++) {
+        out[i] = tmp[i] + 1;
+    }
+}
+
+int test_live_after_loop(const int *restrict in, int *restrict out) {
+    int tmp[10];
+
+    // tmp viene letto dopo i loop: la memoria serve ancora
+    for (int i = 0; i < 10; i++) {
+        tmp[i] = in[i] * 5;
+    }
+    for (int i = 0; i < 10; i++) {
+        out[i] = tmp[i] + 1;
+    }
+    return tmp[3];
+}
+
+void test_shifted_read(const int *restrict in, int *restrict out) {
+    int tmp[10];
+
+    // I loop si fondono, ma tmp[i - 1] è stato scritto nell'iterazione
+    // precedente: il valore non è quello appena calcolato e l'array resta
+    for (int i = 0; i < 10; i++) {
+        tmp[i] = in[i] * 5;
+    }
+    for (int i = 1; i < 10; i++) {
+        out[i] = tmp[i] - tmp[i - 1];
+    }
+}
@@ -0,0 +1,47 @@
+#include <stdio.h>
+
+#define N 18
+#define M 16
+
+// Prodotto matrice-vettore: il loop interno accumula una riduzione. Con
+// unroll-and-jam ogni caricamento di X[j] serve più righe di A, e le
+// riduzioni delle righe procedono in parallelo. Le due righe in eccesso
+// rispetto al fattore finiscono in un loop separato. A, X e Y sono array
+// distinti: lo store in Y[i] scende sotto la copia successiva del loop
+// interno senza toccare la memoria che questa legge.
+int A[N][M], X[M], Y[N];
+
+void test_matvec() {
+    for (int i = 0; i < N; i++) {
+        int sum = 0;
+        for (int j = 0; j < M; j++) {
+            sum += A[i][j] * X[j];
+        }
+        Y[i] = sum;
+    }
+}
+
+// a[i + 1][j] dipende da a[i][j + 1]: fondere le copie del loop interno
+// leggerebbe valori non ancora scritti, il nest non viene srotolato
+void test_not_jammable(int a[N][M]) {
+    for (int i = 0; i < N - 1; i++) {
+        for (int j = 0; j < M - 1; j++) {
+            a[i + 1][j] = a[i][j + 1] + 1;
+        }
+    }
+}
+
+int main() {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            A[i][j] = (i * 7 + j) % 13;
+        }
+    }
+    for (int j = 0; j < M; j++) {
+        X[j] = j % 5;
+    }
+    test_matvec();
+    test_not_jammable(A);
+    printf("%d %d %d\n", Y[0], Y[N - 1], A[N - 1][0]);
+    return 0;
+}
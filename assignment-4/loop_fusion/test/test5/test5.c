@@ -0,0 +1,18 @@
+void test_chain() {
+    int A[10], B[10], C[10], D[10];
+
+    // Quattro loop adiacenti e compatibili, ognuno rilegge l'array scritto
+    // dal precedente: devono diventare un solo loop
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+    }
+    for (int i = 0; i < 10; i++) {
+        B[i] = A[i] * 2;
+    }
+    for (int i = 0; i < 10; i++) {
+        C[i] = B[i] * 3;
+    }
+    for (int i = 0; i < 10; i++) {
+        D[i] = C[i] * 4;
+    }
+}
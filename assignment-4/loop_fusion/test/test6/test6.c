@@ -0,0 +1,28 @@
+void test_forward(int *out) {
+    int A[11], B[11];
+
+    // Il secondo loop legge A[i] scritto dal primo nella stessa iterazione:
+    // dipendenza con distanza 0, la fusione è lecita
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+    }
+    for (int i = 0; i < 10; i++) {
+        B[i] = A[i] * 3;
+    }
+    out[0] = B[7];
+}
+
+void test_backward(int *out) {
+    int A[11], B[11];
+
+    A[10] = 0;
+    // Il secondo loop legge A[i + 1], scritto dal primo all'iterazione
+    // successiva: distanza negativa, la fusione non è lecita
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+    }
+    for (int i = 0; i < 10; i++) {
+        B[i] = A[i + 1] * 3;
+    }
+    out[0] = B[7];
+}
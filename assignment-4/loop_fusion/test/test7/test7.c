@@ -0,0 +1,27 @@
+void test_stencil(int *out) {
+    int A[12], B[12];
+
+    // Il primo loop ha due iterazioni in più: vengono separate in testa e il
+    // resto si fonde con lo stencil, che legge A[i + 1] già scritto
+    for (int i = 0; i < 12; i++) {
+        A[i] = i;
+    }
+    for (int i = 1; i < 11; i++) {
+        B[i] = A[i - 1] + A[i + 1];
+    }
+    out[0] = B[5] + B[10];
+}
+
+void test_longer_second(int *out) {
+    int A[12], B[12];
+
+    // Il secondo loop ha due iterazioni in più: vengono separate in coda
+    A[10] = A[11] = 0;
+    for (int i = 0; i < 10; i++) {
+        A[i] = i;
+    }
+    for (int i = 0; i < 12; i++) {
+        B[i] = A[i] * 3;
+    }
+    out[0] = A[9] + B[11];
+}
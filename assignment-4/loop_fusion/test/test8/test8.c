@@ -0,0 +1,13 @@
+// Da eseguire con -passes=loop_fusion_runtime: i bound arrivano dai
+// parametri, quindi la fusione avviene solo nel ramo in cui n == m
+void test_runtime_bounds(int *out, int n, int m) {
+    int A[100], B[100];
+
+    for (int i = 0; i < n; i++) {
+        A[i] = i;
+    }
+    for (int i = 0; i < m; i++) {
+        B[i] = A[i] * 3;
+    }
+    out[0] = B[n / 2];
+}
@@ -0,0 +1,38 @@
+#define N 64
+#define M 64
+
+void test_nests(int *out) {
+    int A[N][M], B[N][M];
+
+    // Due nest sullo stesso dominio 2-D: si fondono i loop esterni e poi
+    // quelli interni
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            A[i][j] = i * M + j;
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            B[i][j] = A[i][j] * 2;
+        }
+    }
+    out[0] = B[3][4];
+}
+
+void test_nests_next_row(int *out) {
+    int A[N][M], B[N][M];
+
+    // Il secondo nest legge la riga successiva: la prima riga del primo
+    // nest viene separata e il resto si fonde
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            A[i][j] = i * M + j;
+        }
+    }
+    for (int i = 0; i < N - 1; i++) {
+        for (int j = 0; j < M; j++) {
+            B[i][j] = A[i + 1][j] * 2;
+        }
+    }
+    out[0] = B[3][4];
+}
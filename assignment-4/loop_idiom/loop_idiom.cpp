@@ -0,0 +1,276 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/LoopAccessAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Scalar/LoopRotation.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/ScalarEvolutionExpander.h"
+
+using namespace llvm;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Riconoscimento degli idiomi memset/memcpy/memmove: un loop che scrive con
+// passo unitario un valore costante, o che copia un array in un altro,
+// viene sostituito da una chiamata all'intrinseco corrispondente nel
+// preheader, e il loop viene eliminato. SCEV ricava indirizzo iniziale,
+// passo e numero di iterazioni; LoopAccessAnalysis dice se sorgente e
+// destinazione di una copia possono sovrapporsi.
+namespace {
+
+// Descrizione di un accesso a memoria con passo unitario: Base è
+// l'indirizzo della prima iterazione
+struct StridedAccess {
+    const SCEV *Base;
+    uint64_t Size;
+};
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    // Dentro le implementazioni di libc il loop è la funzione stessa
+    if (F.getName() == "memset" || F.getName() == "memcpy" || F.getName() == "memmove")
+        return PreservedAnalyses::all();
+
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &LAIs = FAM.getResult<LoopAccessAnalysis>(F);
+
+    // I loop riconosciuti vengono eliminati: la worklist va costruita prima
+    SmallVector<Loop *, 8> Worklist;
+    for (Loop *TopLevelLoop : LI) {
+        for (Loop *L : depth_first(TopLevelLoop)) {
+            if (L->isInnermost()) {
+                Worklist.push_back(L);
+            }
+        }
+    }
+
+    bool Changed = false;
+    for (Loop *L : Worklist) {
+        if (!isIdiomCandidate(L, SE))
+            continue;
+        StoreInst *SI = getIdiomStore(L, DT);
+        if (!SI)
+            continue;
+
+        const DataLayout &DL = F.getParent()->getDataLayout();
+        StridedAccess Dst;
+        if (!getStridedAccess(SI->getPointerOperand(), SI->getValueOperand()->getType(), L, SE, DL, Dst))
+            continue;
+
+        bool Replaced = false;
+        if (Value *Byte = getMemsetByte(SI, L, DL)) {
+            Replaced = replaceWithMemset(L, SI, Byte, Dst, SE, DL);
+        } else if (auto *LdI = getCopiedLoad(SI, L)) {
+            StridedAccess Src;
+            if (getStridedAccess(LdI->getPointerOperand(), LdI->getType(), L, SE, DL, Src))
+                Replaced = replaceWithCopy(L, SI, LdI, Dst, Src, LAIs.getInfo(*L), SE, DL);
+        }
+        if (!Replaced)
+            continue;
+
+        deleteDeadLoop(L, &DT, &SE, &LI);
+        // Le informazioni di LAA non valgono più per i loop modificati
+        LAIs.clear();
+        Changed = true;
+    }
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+bool isIdiomCandidate(Loop *L, ScalarEvolution &SE) {
+        // Loop semplificato e ruotato con un'unica uscita nel latch: il body
+        // viene eseguito BTC + 1 volte
+        if (!L->isLoopSimplifyForm() || !L->isRotatedForm() || !L->getExitingBlock() ||
+            !L->getUniqueExitBlock()) {
+            errs() << "Loop is not in simplified rotated form\n";
+            return false;
+        }
+        if (isa<SCEVCouldNotCompute>(SE.getBackedgeTakenCount(L))) {
+            errs() << "Loop trip count is not computable\n";
+            return false;
+        }
+        // Dopo la sostituzione il loop viene eliminato: nessun valore
+        // calcolato nel loop può servire dopo
+        for (PHINode &PN : L->getUniqueExitBlock()->phis()) {
+            errs() << "Loop has live-out value " << PN.getName() << "\n";
+            return false;
+        }
+        for (BasicBlock *BB : L->blocks())
+            for (Instruction &I : *BB)
+                for (User *U : I.users())
+                    if (!L->contains(cast<Instruction>(U))) {
+                        errs() << "Loop has live-out value " << I.getName() << "\n";
+                        return false;
+                    }
+        return true;
+}
+
+// L'unico accesso in scrittura del loop, eseguito in ogni iterazione. Le
+// altre istruzioni non possono avere effetti collaterali.
+StoreInst *getIdiomStore(Loop *L, DominatorTree &DT) {
+        StoreInst *Store = nullptr;
+        for (BasicBlock *BB : L->blocks()) {
+            for (Instruction &I : *BB) {
+                if (auto *SI = dyn_cast<StoreInst>(&I)) {
+                    if (Store || !SI->isSimple())
+                        return nullptr;
+                    Store = SI;
+                } else if (I.mayWriteToMemory() || I.mayHaveSideEffects()) {
+                    return nullptr;
+                }
+            }
+        }
+        if (!Store || !DT.dominates(Store->getParent(), L->getLoopLatch()))
+            return nullptr;
+        return Store;
+}
+
+// Ptr deve avanzare di un elemento di tipo Ty per iterazione
+bool getStridedAccess(Value *Ptr, Type *Ty, Loop *L, ScalarEvolution &SE, const DataLayout &DL,
+                      StridedAccess &Access) {
+        uint64_t Size = DL.getTypeStoreSize(Ty);
+        if (Size == 0 || Size != DL.getTypeAllocSize(Ty))
+            return false;
+        auto *AR = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(Ptr));
+        if (!AR || AR->getLoop() != L || !AR->isAffine())
+            return false;
+        auto *Stride = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+        if (!Stride || Stride->getAPInt() != Size)
+            return false;
+        Access = {AR->getStart(), Size};
+        return true;
+}
+
+// Il valore scritto è invariante e formato da un byte ripetuto
+Value *getMemsetByte(StoreInst *SI, Loop *L, const DataLayout &DL) {
+        Value *V = SI->getValueOperand();
+        if (!L->isLoopInvariant(V))
+            return nullptr;
+        Value *Byte = isBytewiseValue(V, DL);
+        return Byte && !isa<UndefValue>(Byte) ? Byte : nullptr;
+}
+
+// Il valore scritto è letto nella stessa iterazione e serve solo alla store
+LoadInst *getCopiedLoad(StoreInst *SI, Loop *L) {
+        auto *LdI = dyn_cast<LoadInst>(SI->getValueOperand());
+        if (!LdI || !LdI->isSimple() || !LdI->hasOneUse() || LdI->getParent() != SI->getParent())
+            return nullptr;
+        return LdI;
+}
+
+// Byte scritti dal loop: (BTC + 1) * Size
+Value *expandLength(Loop *L, uint64_t Size, SCEVExpander &Expander, ScalarEvolution &SE,
+                    const DataLayout &DL, Instruction *InsertPt) {
+        Type *IntPtrTy = DL.getIntPtrType(InsertPt->getContext());
+        const SCEV *BTC = SE.getTruncateOrZeroExtend(SE.getBackedgeTakenCount(L), IntPtrTy);
+        const SCEV *Count = SE.getAddExpr(BTC, SE.getOne(IntPtrTy), SCEV::FlagNUW);
+        const SCEV *Length = SE.getMulExpr(Count, SE.getConstant(IntPtrTy, Size), SCEV::FlagNUW);
+        return Expander.expandCodeFor(Length, IntPtrTy, InsertPt);
+}
+
+bool replaceWithMemset(Loop *L, StoreInst *SI, Value *Byte, const StridedAccess &Dst, ScalarEvolution &SE,
+                       const DataLayout &DL) {
+        Instruction *InsertPt = L->getLoopPreheader()->getTerminator();
+        SCEVExpander Expander(SE, DL, "loop-idiom");
+        Value *Ptr = Expander.expandCodeFor(Dst.Base, SI->getPointerOperandType(), InsertPt);
+        Value *Length = expandLength(L, Dst.Size, Expander, SE, DL, InsertPt);
+
+        IRBuilder<> Builder(InsertPt);
+        Builder.CreateMemSet(Ptr, Byte, Length, SI->getAlign());
+        errs() << "Replaced loop " << L->getHeader()->getName() << " with memset\n";
+        return true;
+}
+
+// Senza dipendenze tra lettura e scrittura la copia è un memcpy. Se
+// sorgente e destinazione stanno nello stesso oggetto, il loop copia in
+// avanti: equivale a memmove solo se la destinazione precede la sorgente.
+bool replaceWithCopy(Loop *L, StoreInst *SI, LoadInst *LdI, const StridedAccess &Dst,
+                     const StridedAccess &Src, const LoopAccessInfo &LAI, ScalarEvolution &SE,
+                     const DataLayout &DL) {
+        if (!LAI.canVectorizeMemory()) {
+            errs() << "Copy reads values written by earlier iterations\n";
+            return false;
+        }
+        if (LAI.getNumRuntimePointerChecks() > 0) {
+            errs() << "Source and destination may alias\n";
+            return false;
+        }
+        const auto *Deps = LAI.getDepChecker().getDependences();
+        if (!Deps)
+            return false;
+        bool IsMemmove = !Deps->empty();
+        if (IsMemmove) {
+            auto *Distance = dyn_cast<SCEVConstant>(SE.getMinusSCEV(Dst.Base, Src.Base));
+            if (!Distance || !Distance->getAPInt().isNegative()) {
+                errs() << "Copy reads values written by earlier iterations\n";
+                return false;
+            }
+        }
+
+        Instruction *InsertPt = L->getLoopPreheader()->getTerminator();
+        SCEVExpander Expander(SE, DL, "loop-idiom");
+        Value *DstPtr = Expander.expandCodeFor(Dst.Base, SI->getPointerOperandType(), InsertPt);
+        Value *SrcPtr = Expander.expandCodeFor(Src.Base, LdI->getPointerOperandType(), InsertPt);
+        Value *Length = expandLength(L, Dst.Size, Expander, SE, DL, InsertPt);
+
+        IRBuilder<> Builder(InsertPt);
+        if (IsMemmove)
+            Builder.CreateMemMove(DstPtr, SI->getAlign(), SrcPtr, LdI->getAlign(), Length);
+        else
+            Builder.CreateMemCpy(DstPtr, SI->getAlign(), SrcPtr, LdI->getAlign(), Length);
+        errs() << "Replaced loop " << L->getHeader()->getName() << " with "
+               << (IsMemmove ? "memmove" : "memcpy") << "\n";
+        return true;
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "loopIdiom", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "loop_idiom") {
+                    // LoopAccessAnalysis lavora solo su loop ruotati
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(createFunctionToLoopPassAdaptor(LoopRotatePass()));
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
@@ -0,0 +1,56 @@
+#include <stdio.h>
+
+#define N 1024
+
+int A[N], B[N];
+
+// Scrittura di un byte ripetuto: memset
+void test_memset(int n) {
+    for (int i = 0; i < n; i++) {
+        A[i] = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        B[i] = -1;
+    }
+}
+
+// Due array distinti: LoopAccessAnalysis non trova dipendenze, memcpy
+void test_memcpy(int n) {
+    for (int i = 0; i < n; i++) {
+        B[i] = A[i];
+    }
+}
+
+// Stesso array, la destinazione precede la sorgente: memmove
+void test_memmove(int n) {
+    for (int i = 0; i < n - 1; i++) {
+        A[i] = A[i + 1];
+    }
+}
+
+// La destinazione segue la sorgente: ogni iterazione legge il valore
+// scritto da quella precedente, il loop resta invariato
+void test_propagate(int n) {
+    for (int i = 0; i < n - 1; i++) {
+        A[i + 1] = A[i];
+    }
+}
+
+// Valore non formato da un byte ripetuto: nessun memset
+void test_pattern(int n) {
+    for (int i = 0; i < n; i++) {
+        B[i] = 5;
+    }
+}
+
+int main() {
+    test_memset(N);
+    for (int i = 0; i < N; i++)
+        A[i] = i * 3;
+    test_memcpy(N / 2);
+    test_memmove(N);
+    test_propagate(N / 4);
+    test_pattern(10);
+    printf("%d %d %d %d\n", A[0], A[N - 2], B[7], B[N / 2 + 1]);
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "../common/loop_nest.h"
+#include <algorithm>
+#include <numeric>
+
+using namespace llvm;
+using namespace loop_nest;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Interscambio dei loop di un nest perfetto di profondità 2 o 3: sceglie
+// l'ordine in cui il loop più interno scorre la memoria con il passo più
+// piccolo, purché le dipendenze lo permettano. Il CFG non cambia: a ogni
+// livello si sposta il controllo (variabile di induzione, incremento e
+// condizione di uscita) del loop che deve occuparlo.
+namespace {
+
+// Dimensione della linea di cache se TargetTransformInfo non la conosce
+static const unsigned DefaultCacheLineSize = 64;
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &DI = FAM.getResult<DependenceAnalysis>(F);
+    auto &TTI = FAM.getResult<TargetIRAnalysis>(F);
+
+    unsigned CacheLineSize = TTI.getCacheLineSize();
+    if (CacheLineSize == 0)
+        CacheLineSize = DefaultCacheLineSize;
+
+    bool Changed = false;
+    for (Loop *Root : LI) {
+        SmallVector<Loop *, 3> Nest;
+        SmallVector<LoopControl, 3> Controls;
+        if (!collectPerfectNest(Root, SE, "interchange", Nest, Controls))
+            continue;
+
+        SmallVector<unsigned, 3> Order;
+        if (!chooseLoopOrder(Nest, DI, SE, CacheLineSize, Order))
+            continue;
+
+        errs() << "Interchanging nest " << Root->getHeader()->getName() << " to order";
+        for (unsigned Level : Order)
+            errs() << " " << Level;
+        errs() << "\n";
+        SE.forgetLoop(Root);
+        permuteNest(Nest, Controls, Order);
+        Changed = true;
+    }
+
+    if (!Changed)
+        return PreservedAnalyses::all();
+    // I blocchi e gli archi restano gli stessi
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    PA.preserve<LoopAnalysis>();
+    return PA;
+}
+
+// L'ordine è lecito se nessuna dipendenza può diventare
+// lessicograficamente negativa: scorrendo i livelli nel nuovo ordine, un
+// '>' non può comparire finché tutti i livelli precedenti possono essere '='
+bool isLegalOrder(ArrayRef<SmallVector<unsigned, 3>> Directions, ArrayRef<unsigned> Order) {
+    for (const auto &Dir : Directions) {
+        for (unsigned Level : Order) {
+            if (Dir[Level] & Dependence::DVEntry::GT)
+                return false;
+            if (!(Dir[Level] & Dependence::DVEntry::EQ))
+                break;
+        }
+    }
+    return true;
+}
+
+// Modello di costo: linee di cache toccate per iterazione se il loop Level
+// è il più interno. Un accesso invariante rispetto al loop riusa la stessa
+// linea, uno con passo minore della linea ne cambia una ogni
+// CacheLineSize / passo iterazioni, gli altri una a ogni iterazione.
+double getInnermostCost(ArrayRef<Loop *> Nest, unsigned Level, ScalarEvolution &SE,
+                        unsigned CacheLineSize) {
+    double Cost = 0;
+    for (BasicBlock *BB : Nest.back()->blocks()) {
+        for (Instruction &I : *BB) {
+            Value *Ptr = getLoadStorePointerOperand(&I);
+            if (!Ptr)
+                continue;
+
+            const SCEV *S = SE.getSCEV(Ptr);
+            const SCEV *Step = nullptr;
+            while (auto *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+                if (AR->getLoop() == Nest[Level]) {
+                    Step = AR->getStepRecurrence(SE);
+                    break;
+                }
+                S = AR->getStart();
+            }
+            if (!Step) {
+                if (SE.isLoopInvariant(SE.getSCEV(Ptr), Nest[Level]))
+                    continue;
+                Cost += 1;
+                continue;
+            }
+
+            auto *C = dyn_cast<SCEVConstant>(Step);
+            if (!C) {
+                Cost += 1;
+                continue;
+            }
+            uint64_t Stride = C->getAPInt().abs().getZExtValue();
+            Cost += Stride >= CacheLineSize ? 1.0 : double(Stride) / CacheLineSize;
+        }
+    }
+    return Cost;
+}
+
+// Sceglie, tra gli ordini leciti, quello che minimizza il costo del loop più
+// interno e poi dei livelli più esterni. Order[k] è il livello originale
+// che finisce in posizione k; restituisce false se conviene l'ordine attuale.
+bool chooseLoopOrder(ArrayRef<Loop *> Nest, DependenceInfo &DI, ScalarEvolution &SE,
+                     unsigned CacheLineSize, SmallVectorImpl<unsigned> &Order) {
+    SmallVector<SmallVector<unsigned, 3>, 16> Directions;
+    if (!collectDirections(Nest, DI, SE, Directions))
+        return false;
+
+    SmallVector<double, 3> Costs;
+    for (unsigned Level = 0; Level < Nest.size(); ++Level) {
+        Costs.push_back(getInnermostCost(Nest, Level, SE, CacheLineSize));
+        errs() << "Cost with loop " << Level << " innermost: " << Costs.back() << "\n";
+    }
+
+    // Un ordine è migliore se il suo loop più interno costa meno; a parità
+    // conta il livello successivo verso l'esterno
+    auto Better = [&](ArrayRef<unsigned> A, ArrayRef<unsigned> B) {
+        for (unsigned k = A.size(); k-- > 0;) {
+            if (Costs[A[k]] != Costs[B[k]])
+                return Costs[A[k]] < Costs[B[k]];
+        }
+        return false;
+    };
+
+    SmallVector<unsigned, 3> Identity(Nest.size());
+    std::iota(Identity.begin(), Identity.end(), 0);
+    SmallVector<unsigned, 3> Best = Identity;
+    SmallVector<unsigned, 3> Candidate = Identity;
+    while (std::next_permutation(Candidate.begin(), Candidate.end())) {
+        if (!Better(Candidate, Best))
+            continue;
+        if (!isLegalOrder(Directions, Candidate)) {
+            errs() << "Loop order is not legal for the dependences\n";
+            continue;
+        }
+        Best = Candidate;
+    }
+
+    if (Best == Identity) {
+        errs() << "Current loop order is already the best legal one\n";
+        return false;
+    }
+    Order.assign(Best.begin(), Best.end());
+    return true;
+}
+
+// Porta il controllo del livello originale Order[k] al livello k, con
+// scambi tra livelli adiacenti
+void permuteNest(ArrayRef<Loop *> Nest, SmallVectorImpl<LoopControl> &Controls,
+                 ArrayRef<unsigned> Order) {
+    SmallVector<unsigned, 3> Current(Nest.size());
+    std::iota(Current.begin(), Current.end(), 0);
+    for (unsigned k = 0; k < Order.size(); ++k) {
+        unsigned Pos = std::find(Current.begin(), Current.end(), Order[k]) - Current.begin();
+        for (; Pos > k; --Pos) {
+            swapLoopControls(Nest[Pos - 1], Nest[Pos], Controls[Pos - 1], Controls[Pos]);
+            std::swap(Controls[Pos - 1], Controls[Pos]);
+            std::swap(Current[Pos - 1], Current[Pos]);
+        }
+    }
+}
+
+// Scambia il controllo di due loop adiacenti del nest: ognuno riceve la
+// variabile di induzione, l'incremento e il confronto dell'altro, mentre
+// body e CFG restano invariati
+void swapLoopControls(Loop *Outer, Loop *Inner, LoopControl &OuterControl,
+                      LoopControl &InnerControl) {
+    BasicBlock *OuterPreheader = Outer->getLoopPreheader();
+    BasicBlock *InnerPreheader = Inner->getLoopPreheader();
+    BasicBlock *OuterHeader = Outer->getHeader();
+    BasicBlock *InnerHeader = Inner->getHeader();
+    BasicBlock *OuterLatch = Outer->getLoopLatch();
+    BasicBlock *InnerLatch = Inner->getLoopLatch();
+
+    OuterControl.IV->moveBefore(&InnerHeader->front());
+    OuterControl.IV->replaceIncomingBlockWith(OuterPreheader, InnerPreheader);
+    OuterControl.IV->replaceIncomingBlockWith(OuterLatch, InnerLatch);
+    InnerControl.IV->moveBefore(&OuterHeader->front());
+    InnerControl.IV->replaceIncomingBlockWith(InnerPreheader, OuterPreheader);
+    InnerControl.IV->replaceIncomingBlockWith(InnerLatch, OuterLatch);
+
+    OuterControl.Next->moveBefore(InnerLatch->getTerminator());
+    InnerControl.Next->moveBefore(OuterLatch->getTerminator());
+
+    auto *OuterBranch = cast<BranchInst>(OuterHeader->getTerminator());
+    auto *InnerBranch = cast<BranchInst>(InnerHeader->getTerminator());
+    OuterControl.Cmp->moveBefore(InnerBranch);
+    InnerControl.Cmp->moveBefore(OuterBranch);
+    OuterBranch->setCondition(InnerControl.Cmp);
+    InnerBranch->setCondition(OuterControl.Cmp);
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "loopInterchange", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "loop_interchange") {
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
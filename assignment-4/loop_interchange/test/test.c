@@ -0,0 +1,50 @@
+#include <stdio.h>
+
+#define N 16
+
+int A[N][N], B[N][N], C[N][N];
+
+// Il loop interno scorre le colonne: dopo l'interscambio j diventa il loop
+// esterno e gli accessi diventano consecutivi
+void test_column_major() {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            A[j][i] = A[j][i] * 3 + i + j;
+        }
+    }
+}
+
+// Dipendenza con direzioni (<, >): scambiando i loop la lettura
+// avverrebbe prima della scrittura, l'ordine deve restare questo
+void test_illegal() {
+    for (int i = 0; i < N - 1; i++) {
+        for (int j = 0; j < N - 1; j++) {
+            A[j + 1][i] = A[j][i + 1] + 1;
+        }
+    }
+}
+
+// Prodotto di matrici nell'ordine j, k, i: il loop su j va portato al
+// livello più interno
+void test_matmul() {
+    for (int j = 0; j < N; j++) {
+        for (int k = 0; k < N; k++) {
+            for (int i = 0; i < N; i++) {
+                C[i][j] += A[i][k] * B[k][j];
+            }
+        }
+    }
+}
+
+int main() {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            B[i][j] = i - j;
+        }
+    }
+    test_column_major();
+    test_illegal();
+    test_matmul();
+    printf("%d %d %d\n", A[3][5], A[15][14], C[7][2]);
+    return 0;
+}
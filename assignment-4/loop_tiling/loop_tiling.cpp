@@ -0,0 +1,266 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/IVDescriptors.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "../common/loop_nest.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace loop_nest;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Tiling di un nest perfetto di profondità 2 o 3: ogni loop viene diviso in
+// un loop sui tile e un loop sui punti del tile, e i loop sui tile vengono
+// portati fuori da tutto il nest. Così il nest lavora su blocchi di dati che
+// restano in cache invece di scorrere intere righe e colonne.
+namespace {
+
+// Dimensione della cache L1 dati se TargetTransformInfo non la conosce
+static const unsigned DefaultL1CacheSize = 32 * 1024;
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Lato dei tile scelto nella pipeline (loop_tiling<N>); 0 se va ricavato
+  // dalla dimensione della cache
+  unsigned TileSize;
+
+  TestPass(unsigned TileSize = 0) : TileSize(TileSize) {}
+
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &DI = FAM.getResult<DependenceAnalysis>(F);
+    auto &TTI = FAM.getResult<TargetIRAnalysis>(F);
+
+    unsigned CacheSize = DefaultL1CacheSize;
+    if (auto Size = TTI.getCacheSize(TargetTransformInfo::CacheLevel::L1D))
+        CacheSize = *Size;
+
+    // Il tiling aggiunge loop: i nest vanno raccolti prima
+    SmallVector<Loop *, 8> Roots(LI.begin(), LI.end());
+
+    bool Changed = false;
+    for (Loop *Root : Roots) {
+        SmallVector<Loop *, 3> Nest;
+        SmallVector<LoopControl, 3> Controls;
+        if (!collectPerfectNest(Root, SE, "tiling", Nest, Controls))
+            continue;
+        if (!all_of(Controls, isIncreasingLoop))
+            continue;
+        if (!isTilingLegal(Nest, DI, SE))
+            continue;
+
+        unsigned Tile = TileSize ? TileSize : getTileSize(Nest, CacheSize);
+        if (Tile < 2) {
+            errs() << "Tile size too small\n";
+            continue;
+        }
+        if (fitsInOneTile(Nest, SE, Tile)) {
+            errs() << "Loop nest fits in a single tile\n";
+            continue;
+        }
+
+        errs() << "Tiling nest " << Root->getHeader()->getName() << " with tile size " << Tile << "\n";
+        SE.forgetLoop(Root);
+        tileNest(Nest, Controls, Tile);
+        // ScalarEvolution usa il dominator tree per i nest successivi
+        DT.recalculate(F);
+        Changed = true;
+    }
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+// Il tile di ogni livello si ottiene sostituendo inizio e limite: serve
+// un loop crescente che continua finché IV < limite
+static bool isIncreasingLoop(const LoopControl &Control) {
+    ICmpInst *Cmp = Control.Cmp;
+    if (Cmp->getOperand(0) != Control.IV || Control.Step <= 0 ||
+        (Cmp->getPredicate() != ICmpInst::ICMP_SLT && Cmp->getPredicate() != ICmpInst::ICMP_ULT)) {
+        errs() << "Loop is not an increasing loop with IV < bound\n";
+        return false;
+    }
+    return true;
+}
+
+// Il tiling esegue i punti di un tile prima di passare al tile successivo:
+// per ogni livello l'ordine può cambiare, quindi nessuna dipendenza può
+// avere direzione '>' su un livello del nest (nest completamente permutabile)
+bool isTilingLegal(ArrayRef<Loop *> Nest, DependenceInfo &DI, ScalarEvolution &SE) {
+    SmallVector<SmallVector<unsigned, 3>, 16> Directions;
+    if (!collectDirections(Nest, DI, SE, Directions))
+        return false;
+    for (const auto &Dir : Directions) {
+        for (unsigned Direction : Dir) {
+            if (Direction & Dependence::DVEntry::GT) {
+                errs() << "Dependences do not allow tiling\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Modello di cache: un tile per ogni array toccato dal nest, lato uguale su
+// tutti i livelli. Il lato è la più grande potenza di due per cui i tile di
+// due livelli (il caso del prodotto di matrici) stanno in metà della L1,
+// lasciando l'altra metà ai conflitti.
+unsigned getTileSize(ArrayRef<Loop *> Nest, unsigned CacheSize) {
+    SmallPtrSet<const Value *, 8> Objects;
+    uint64_t ElemSize = 1;
+    for (BasicBlock *BB : Nest.back()->blocks()) {
+        for (Instruction &I : *BB) {
+            Value *Ptr = getLoadStorePointerOperand(&I);
+            if (!Ptr)
+                continue;
+            Objects.insert(getUnderlyingObject(Ptr));
+            const DataLayout &DL = I.getModule()->getDataLayout();
+            ElemSize = std::max<uint64_t>(ElemSize, DL.getTypeStoreSize(getLoadStoreType(&I)).getFixedValue());
+        }
+    }
+    if (Objects.empty())
+        return 0;
+
+    uint64_t Budget = CacheSize / 2 / (Objects.size() * ElemSize);
+    unsigned Tile = 1;
+    while (uint64_t(Tile) * 2 * Tile * 2 <= Budget)
+        Tile *= 2;
+    return Tile;
+}
+
+// Con un numero massimo di iterazioni noto e non più grande del tile, il
+// tiling aggiunge solo controlli
+bool fitsInOneTile(ArrayRef<Loop *> Nest, ScalarEvolution &SE, unsigned Tile) {
+    for (Loop *L : Nest) {
+        auto *BTC = dyn_cast<SCEVConstant>(SE.getConstantMaxBackedgeTakenCount(L));
+        if (!BTC || BTC->getAPInt().ugt(Tile))
+            return false;
+    }
+    return true;
+}
+
+// Costruisce i loop sui tile davanti al nest. Per ogni livello k:
+//
+//   tile.header: tile.iv = phi [inizio, ...], [tile.end, tile.latch]
+//                if (tile.iv < limite) goto tile.body else ...
+//   tile.body:   tile.end = tile.iv + min(limite - tile.iv, Tile * passo)
+//                ... livello k + 1, poi il nest originale
+//   tile.latch:  goto tile.header
+//
+// Il loop originale del livello k parte da tile.iv e si ferma a tile.end.
+// La lunghezza del tile è limitata dalla distanza dal limite, così
+// tile.end non supera mai il limite e non può andare in overflow.
+void tileNest(ArrayRef<Loop *> Nest, ArrayRef<LoopControl> Controls, unsigned Tile) {
+    Loop *Root = Nest.front();
+    BasicBlock *Preheader = Root->getLoopPreheader();
+    BasicBlock *Header = Root->getHeader();
+    BasicBlock *Exit = Root->getExitBlock();
+    Function *F = Header->getParent();
+    LLVMContext &Ctx = F->getContext();
+
+    SmallVector<Value *, 3> Starts;
+    for (unsigned k = 0; k < Nest.size(); ++k)
+        Starts.push_back(Controls[k].IV->getIncomingValueForBlock(Nest[k]->getLoopPreheader()));
+
+    SmallVector<BasicBlock *, 3> TileHeaders, TileBodies, TileLatches;
+    for (unsigned k = 0; k < Nest.size(); ++k) {
+        TileHeaders.push_back(BasicBlock::Create(Ctx, "tile.header", F, Header));
+        TileBodies.push_back(BasicBlock::Create(Ctx, "tile.body", F, Header));
+    }
+    BasicBlock *PointPreheader = BasicBlock::Create(Ctx, "tile.point.preheader", F, Header);
+    for (unsigned k = Nest.size(); k-- > 0;)
+        TileLatches.push_back(BasicBlock::Create(Ctx, "tile.latch", F, Exit));
+    std::reverse(TileLatches.begin(), TileLatches.end());
+
+    // Il nest originale diventa il body del loop sui tile più interno
+    Preheader->getTerminator()->replaceUsesOfWith(Header, TileHeaders.front());
+    for (PHINode &PN : Header->phis())
+        PN.replaceIncomingBlockWith(Preheader, PointPreheader);
+    cast<BranchInst>(Header->getTerminator())->setSuccessor(1, TileLatches.back());
+    BranchInst::Create(Header, PointPreheader);
+    for (PHINode &PN : Exit->phis())
+        PN.replaceIncomingBlockWith(Header, TileHeaders.front());
+
+    for (unsigned k = 0; k < Nest.size(); ++k) {
+        const LoopControl &Control = Controls[k];
+        Type *Ty = Control.IV->getType();
+        Value *Bound = Control.Cmp->getOperand(1);
+        BasicBlock *Entry = k == 0 ? Preheader : TileBodies[k - 1];
+        BasicBlock *Out = k == 0 ? Exit : TileLatches[k - 1];
+        BasicBlock *PointEntry = k == 0 ? PointPreheader : Nest[k]->getLoopPreheader();
+
+        IRBuilder<> Builder(TileHeaders[k]);
+        PHINode *TileIV = Builder.CreatePHI(Ty, 2, "tile.iv");
+        TileIV->addIncoming(Starts[k], Entry);
+        Value *Cond = Builder.CreateICmp(Control.Cmp->getPredicate(), TileIV, Bound, "tile.cmp");
+        Builder.CreateCondBr(Cond, TileBodies[k], Out);
+
+        Builder.SetInsertPoint(TileBodies[k]);
+        Value *Length = ConstantInt::get(Ty, uint64_t(Tile) * Control.Step);
+        Value *Remaining = Builder.CreateSub(Bound, TileIV, "tile.remaining");
+        Value *Full = Builder.CreateICmpUGT(Remaining, Length);
+        Value *TileEnd = Builder.CreateAdd(TileIV, Builder.CreateSelect(Full, Length, Remaining), "tile.end");
+        Builder.CreateBr(k + 1 < Nest.size() ? TileHeaders[k + 1] : PointPreheader);
+
+        Builder.SetInsertPoint(TileLatches[k]);
+        Builder.CreateBr(TileHeaders[k]);
+        TileIV->addIncoming(TileEnd, TileLatches[k]);
+
+        Control.IV->setIncomingValueForBlock(PointEntry, TileIV);
+        Control.Cmp->setOperand(1, TileEnd);
+    }
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "loopTiling", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  // loop_tiling<N> fissa il lato dei tile a N
+                  unsigned TileSize = 0;
+                  if (Name == "loop_tiling" ||
+                      (Name.consume_front("loop_tiling<") && Name.consume_back(">") &&
+                       !Name.getAsInteger(10, TileSize))) {
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(TestPass(TileSize));
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
@@ -0,0 +1,51 @@
+#include <stdio.h>
+
+#define N 256
+
+int A[N][N], B[N][N], C[N][N];
+
+// Prodotto di matrici: con tile di lato T le righe di A e le colonne di B
+// vengono riusate finché restano in cache
+void test_matmul() {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            for (int k = 0; k < N; k++) {
+                C[i][j] += A[i][k] * B[k][j];
+            }
+        }
+    }
+}
+
+// Stencil con dipendenze (<, =) e (=, <): il nest è completamente
+// permutabile e si può dividere in tile
+void test_stencil() {
+    for (int i = 0; i < N - 1; i++) {
+        for (int j = 0; j < N - 1; j++) {
+            A[i + 1][j + 1] = A[i][j + 1] + A[i + 1][j];
+        }
+    }
+}
+
+// Dipendenza con direzioni (<, >): i tile cambierebbero l'ordine tra
+// scrittura e lettura, il nest resta invariato
+void test_illegal() {
+    for (int i = 0; i < N - 1; i++) {
+        for (int j = 0; j < N - 1; j++) {
+            B[i + 1][j] = B[i][j + 1] + 1;
+        }
+    }
+}
+
+int main() {
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            A[i][j] = (i + j) % 7;
+            B[i][j] = (i * j) % 5;
+        }
+    }
+    test_matmul();
+    test_stencil();
+    test_illegal();
+    printf("%d %d %d\n", C[17][42], A[N - 1][N - 1] % 1000, B[100][3]);
+    return 0;
+}
@@ -0,0 +1,426 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "../common/loop_nest.h"
+#include <optional>
+
+using namespace llvm;
+using namespace loop_nest;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Unrolling dei loop più interni guidato dal trip count. I loop con poche
+// iterazioni note (come i loop da 10 iterazioni dei test della loop fusion)
+// vengono srotolati completamente: la variabile di induzione diventa una
+// costante in ogni copia e le espressioni che ne dipendono si semplificano.
+// Gli altri vengono srotolati di un fattore limitato dal budget di codice di
+// TargetTransformInfo. Il codice risultante è in blocchi lineari, su cui
+// possono lavorare i pass locali del primo assignment:
+//   opt -load-pass-plugin libloop_unroll.so -passes=loop_unroll
+//   opt -load-pass-plugin libalgebraic_identity.so -passes=local-opts
+namespace {
+
+// Budget di istruzioni se TargetTransformInfo non ne indica uno; quello
+// parziale è anche il minimo accettato dal target
+static const unsigned DefaultFullUnrollThreshold = 150;
+static const unsigned DefaultPartialUnrollThreshold = 150;
+static const unsigned MaxUnrollFactor = 8;
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &TTI = FAM.getResult<TargetIRAnalysis>(F);
+    auto &ORE = FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+
+    // L'unrolling elimina o modifica i loop: la worklist va costruita prima
+    SmallVector<Loop *, 8> Worklist;
+    for (Loop *TopLevelLoop : LI) {
+        for (Loop *L : depth_first(TopLevelLoop)) {
+            if (L->isInnermost()) {
+                Worklist.push_back(L);
+            }
+        }
+    }
+
+    bool Changed = false;
+    for (Loop *L : Worklist) {
+        if (!isUnrollCandidate(L))
+            continue;
+
+        TargetTransformInfo::UnrollingPreferences UP = {};
+        UP.Threshold = DefaultFullUnrollThreshold;
+        UP.PartialThreshold = DefaultPartialUnrollThreshold;
+        UP.MaxCount = MaxUnrollFactor;
+        TTI.getUnrollingPreferences(L, SE, UP, &ORE);
+        // Senza una soglia propria del target, BasicTTIImpl usa come budget
+        // parziale il loop buffer del modello di scheduling (28 micro-op su
+        // x86-64), pensato per loop già ottimizzati: sull'IR -O0 + mem2reg
+        // che riceve questo pass quasi nessun loop ci starebbe
+        UP.PartialThreshold = std::max(UP.PartialThreshold, DefaultPartialUnrollThreshold);
+
+        unsigned LoopSize = getLoopSize(L);
+        // Il trip count di SCEV conta le esecuzioni dell'header: nei loop
+        // non ruotati il body viene eseguito una volta in meno
+        unsigned TripCount = SE.getSmallConstantTripCount(L);
+        unsigned BodyCount = TripCount ? TripCount - 1 : 0;
+
+        bool FullUnroll = TripCount && uint64_t(BodyCount) * LoopSize <= UP.Threshold;
+        unsigned Factor = FullUnroll ? BodyCount : getPartialUnrollFactor(LoopSize, UP);
+        if (!FullUnroll && Factor < 2) {
+            errs() << "Loop " << L->getHeader()->getName() << " is too large to unroll\n";
+            continue;
+        }
+
+        // Le PHI LCSSA nell'uscita raccolgono i valori che le copie
+        // producono per il codice dopo il loop
+        formLCSSA(*L, DT, &LI, &SE);
+        SE.forgetLoop(L);
+
+        if (FullUnroll) {
+            errs() << "Fully unrolling loop " << L->getHeader()->getName() << " with "
+                   << BodyCount << " iterations\n";
+            fullyUnrollLoop(L, BodyCount, LI);
+        } else {
+            errs() << "Unrolling loop " << L->getHeader()->getName() << " by " << Factor << "\n";
+            partiallyUnrollLoop(L, Factor, TripCount ? std::optional<unsigned>(BodyCount) : std::nullopt, LI);
+        }
+        // ScalarEvolution usa il dominator tree per i loop successivi
+        DT.recalculate(F);
+        Changed = true;
+    }
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+// Stessa forma dei loop della loop fusion: l'header decide se uscire e il
+// suo primo successore è il body
+bool isUnrollCandidate(Loop *L) {
+        if (!isHeaderExitingLoop(L, errs(), "unrolling"))
+            return false;
+        // Le copie non possono duplicare istruzioni che non lo permettono
+        for (BasicBlock *BB : L->blocks()) {
+            for (Instruction &I : *BB) {
+                auto *CB = dyn_cast<CallBase>(&I);
+                if (CB && CB->cannotDuplicate()) {
+                    errs() << "Loop contains an instruction that cannot be duplicated\n";
+                    return false;
+                }
+            }
+        }
+        return true;
+}
+
+// Istruzioni eseguite da un'iterazione, esclusi PHI e debug info
+unsigned getLoopSize(Loop *L) {
+    unsigned Size = 0;
+    for (BasicBlock *BB : L->blocks())
+        for (Instruction &I : *BB)
+            if (!isa<PHINode>(I) && !I.isDebugOrPseudoInst())
+                ++Size;
+    return Size;
+}
+
+// La più grande potenza di due entro MaxCount per cui il loop srotolato
+// resta nel budget
+unsigned getPartialUnrollFactor(unsigned LoopSize, const TargetTransformInfo::UnrollingPreferences &UP) {
+    unsigned MaxCount = std::min(UP.MaxCount, MaxUnrollFactor);
+    unsigned Factor = 1;
+    while (Factor * 2 <= MaxCount && uint64_t(Factor) * 2 * LoopSize <= UP.PartialThreshold)
+        Factor *= 2;
+    return Factor;
+}
+
+// Copia tutti i blocchi di L per eseguire un'iterazione: le PHI dell'header
+// vengono sostituite dai valori in Values, che alla fine contiene i valori
+// per l'iterazione successiva. Il latch della copia salta ancora all'header
+// originale. Le copie vengono inserite prima di InsertBefore.
+BasicBlock *cloneIteration(Loop *L, DenseMap<PHINode *, Value *> &Values, ValueToValueMapTy &VMap,
+                           SmallVectorImpl<BasicBlock *> &NewBlocks, BasicBlock *InsertBefore) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Latch = L->getLoopLatch();
+    Function *F = Header->getParent();
+
+    SmallVector<BasicBlock *, 8> Blocks;
+    for (BasicBlock *BB : L->blocks()) {
+        BasicBlock *NewBB = CloneBasicBlock(BB, VMap, ".unroll", F);
+        NewBB->moveBefore(InsertBefore);
+        VMap[BB] = NewBB;
+        Blocks.push_back(NewBB);
+    }
+    remapInstructionsInBlocks(Blocks, VMap);
+    NewBlocks.append(Blocks.begin(), Blocks.end());
+    auto *NewHeader = cast<BasicBlock>(VMap[Header]);
+    cast<BasicBlock>(VMap[Latch])->getTerminator()->replaceUsesOfWith(NewHeader, Header);
+
+    for (PHINode &PN : Header->phis()) {
+        auto *NewPN = cast<PHINode>(VMap[&PN]);
+        NewPN->replaceAllUsesWith(Values[&PN]);
+        NewPN->eraseFromParent();
+        VMap[&PN] = Values[&PN];
+    }
+
+    // I valori che arrivano dal latch sono quelli della copia
+    DenseMap<PHINode *, Value *> NextValues;
+    for (PHINode &PN : Header->phis()) {
+        Value *In = PN.getIncomingValueForBlock(Latch);
+        Value *Mapped = VMap.lookup(In);
+        NextValues[&PN] = Mapped ? Mapped : In;
+    }
+    Values = std::move(NextValues);
+    return NewHeader;
+}
+
+// Sostituisce il salto condizionato dell'header di una copia con un salto
+// al body (l'iterazione viene sicuramente eseguita) o all'uscita. Le PHI
+// dell'altro successore non hanno ancora valori per la copia.
+void forceHeaderBranch(BasicBlock *Header, bool TakeBody) {
+    auto *BI = cast<BranchInst>(Header->getTerminator());
+    BasicBlock *Target = BI->getSuccessor(TakeBody ? 0 : 1);
+    BranchInst::Create(Target, BI);
+    BI->eraseFromParent();
+}
+
+// Le PHI LCSSA dell'uscita ricevono dall'header della copia i valori che
+// l'header originale avrebbe prodotto in quella iterazione
+void addExitIncoming(BasicBlock *Exit, BasicBlock *Header, BasicBlock *NewHeader, ValueToValueMapTy &VMap) {
+    for (PHINode &PN : Exit->phis()) {
+        Value *In = PN.getIncomingValueForBlock(Header);
+        Value *Mapped = VMap.lookup(In);
+        PN.addIncoming(Mapped ? Mapped : In, NewHeader);
+    }
+}
+
+// Esegue in sequenza Count iterazioni di L prima dell'header originale, e
+// restituisce l'ultimo blocco della sequenza (il preheader se Count è 0).
+// Values contiene i valori delle PHI dell'header dopo le iterazioni.
+BasicBlock *emitStraightLineIterations(Loop *L, unsigned Count, DenseMap<PHINode *, Value *> &Values,
+                                       SmallVectorImpl<BasicBlock *> &NewBlocks) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Prev = L->getLoopPreheader();
+    BasicBlock *Exit = L->getExitBlock();
+    for (unsigned k = 0; k < Count; ++k) {
+        ValueToValueMapTy VMap;
+        BasicBlock *NewHeader = cloneIteration(L, Values, VMap, NewBlocks, Exit);
+        forceHeaderBranch(NewHeader, /*TakeBody=*/true);
+        Prev->getTerminator()->replaceUsesOfWith(Header, NewHeader);
+        Prev = cast<BasicBlock>(VMap[L->getLoopLatch()]);
+    }
+    return Prev;
+}
+
+// Unrolling completo: Count iterazioni in sequenza, seguite da un'ultima
+// copia dell'header che esce dal loop. Il loop originale viene eliminato.
+void fullyUnrollLoop(Loop *L, unsigned Count, LoopInfo &LI) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Exit = L->getExitBlock();
+
+    DenseMap<PHINode *, Value *> Values;
+    for (PHINode &PN : Header->phis())
+        Values[&PN] = PN.getIncomingValueForBlock(Preheader);
+
+    SmallVector<BasicBlock *, 16> NewBlocks;
+    BasicBlock *Last = emitStraightLineIterations(L, Count, Values, NewBlocks);
+
+    ValueToValueMapTy VMap;
+    size_t FinalBegin = NewBlocks.size();
+    BasicBlock *FinalHeader = cloneIteration(L, Values, VMap, NewBlocks, Exit);
+    forceHeaderBranch(FinalHeader, /*TakeBody=*/false);
+    Last->getTerminator()->replaceUsesOfWith(Header, FinalHeader);
+    addExitIncoming(Exit, Header, FinalHeader, VMap);
+    Exit->removePredecessor(Header);
+    Header->getTerminator()->replaceUsesOfWith(Exit, Header);
+
+    // Le copie appartengono al loop che conteneva L; i blocchi originali e
+    // il body dell'ultima copia non sono più raggiungibili
+    SmallVector<BasicBlock *, 8> DeadBlocks(L->blocks());
+    SmallVector<BasicBlock *, 16> LiveBlocks{Preheader};
+    Loop *Parent = L->getParentLoop();
+    for (size_t i = 0; i < NewBlocks.size(); ++i) {
+        BasicBlock *BB = NewBlocks[i];
+        if (i >= FinalBegin && BB != FinalHeader) {
+            DeadBlocks.push_back(BB);
+            continue;
+        }
+        LiveBlocks.push_back(BB);
+        if (Parent)
+            Parent->addBasicBlockToLoop(BB, LI);
+    }
+    // Le PHI dell'header hanno come predecessori blocchi ormai staccati
+    for (PHINode &PN : make_early_inc_range(Header->phis())) {
+        PN.replaceAllUsesWith(PoisonValue::get(PN.getType()));
+        PN.eraseFromParent();
+    }
+    for (BasicBlock *BB : DeadBlocks)
+        LI.removeBlock(BB);
+    if (Parent)
+        Parent->removeChildLoop(L);
+    else
+        LI.removeLoop(llvm::find(LI, L));
+    LI.destroy(L);
+    DeleteDeadBlocks(DeadBlocks);
+
+    LiveBlocks.push_back(Exit);
+    simplifyUnrolledCode(LiveBlocks, LI);
+}
+
+// Unrolling parziale di Factor. Con trip count noto le iterazioni in
+// eccesso rispetto a un multiplo di Factor vengono eseguite prima del loop
+// come codice lineare (il loop di resto, srotolato), e le copie nel loop
+// non controllano l'uscita. Con trip count sconosciuto ogni copia mantiene
+// il controllo dell'header.
+void partiallyUnrollLoop(Loop *L, unsigned Factor, std::optional<unsigned> BodyCount, LoopInfo &LI) {
+    BasicBlock *Header = L->getHeader();
+    BasicBlock *Preheader = L->getLoopPreheader();
+    BasicBlock *Latch = L->getLoopLatch();
+    BasicBlock *Exit = L->getExitBlock();
+    Loop *Parent = L->getParentLoop();
+
+    SmallVector<BasicBlock *, 16> NewBlocks;
+    if (BodyCount && *BodyCount % Factor != 0) {
+        DenseMap<PHINode *, Value *> Values;
+        for (PHINode &PN : Header->phis())
+            Values[&PN] = PN.getIncomingValueForBlock(Preheader);
+        BasicBlock *Last = emitStraightLineIterations(L, *BodyCount % Factor, Values, NewBlocks);
+        for (PHINode &PN : Header->phis()) {
+            int Idx = PN.getBasicBlockIndex(Preheader);
+            PN.setIncomingBlock(Idx, Last);
+            PN.setIncomingValue(Idx, Values[&PN]);
+        }
+        // Il loop ha un nuovo preheader
+        if (Parent)
+            for (BasicBlock *BB : NewBlocks)
+                Parent->addBasicBlockToLoop(BB, LI);
+    }
+    size_t PrologueSize = NewBlocks.size();
+
+    DenseMap<PHINode *, Value *> Values;
+    for (PHINode &PN : Header->phis())
+        Values[&PN] = PN.getIncomingValueForBlock(Latch);
+
+    // I latch vengono collegati solo dopo aver creato tutte le copie: fino
+    // ad allora L mantiene il suo latch
+    SmallVector<BasicBlock *, 8> Headers;
+    SmallVector<BasicBlock *, 8> Latches{Latch};
+    for (unsigned k = 1; k < Factor; ++k) {
+        ValueToValueMapTy VMap;
+        BasicBlock *NewHeader = cloneIteration(L, Values, VMap, NewBlocks, Exit);
+        if (BodyCount)
+            forceHeaderBranch(NewHeader, /*TakeBody=*/true);
+        else
+            addExitIncoming(Exit, Header, NewHeader, VMap);
+        Headers.push_back(NewHeader);
+        Latches.push_back(cast<BasicBlock>(VMap[Latch]));
+    }
+    for (unsigned k = 0; k < Headers.size(); ++k)
+        Latches[k]->getTerminator()->replaceUsesOfWith(Header, Headers[k]);
+
+    // L'ultima copia chiude il loop
+    for (PHINode &PN : Header->phis()) {
+        int Idx = PN.getBasicBlockIndex(Latch);
+        PN.setIncomingBlock(Idx, Latches.back());
+        PN.setIncomingValue(Idx, Values[&PN]);
+    }
+    for (size_t i = PrologueSize; i < NewBlocks.size(); ++i)
+        L->addBasicBlockToLoop(NewBlocks[i], LI);
+
+    NewBlocks.append(L->block_begin(), L->block_end());
+    NewBlocks.push_back(Exit);
+    simplifyUnrolledCode(NewBlocks, LI);
+}
+
+// Nelle copie la variabile di induzione è spesso una costante: le
+// istruzioni che ne dipendono si piegano, i rami con condizione costante
+// diventano salti, i blocchi non più raggiungibili vengono eliminati e
+// quelli in sequenza uniti
+void simplifyUnrolledCode(ArrayRef<BasicBlock *> Blocks, LoopInfo &LI) {
+    const DataLayout &DL = Blocks.front()->getModule()->getDataLayout();
+    BasicBlock *Entry = &Blocks.front()->getParent()->getEntryBlock();
+    for (BasicBlock *BB : Blocks) {
+        for (Instruction &I : make_early_inc_range(*BB)) {
+            if (Value *V = simplifyInstruction(&I, SimplifyQuery(DL, &I))) {
+                I.replaceAllUsesWith(V);
+                if (isInstructionTriviallyDead(&I))
+                    I.eraseFromParent();
+            } else {
+                RecursivelyDeleteTriviallyDeadInstructions(&I);
+            }
+        }
+    }
+    for (BasicBlock *BB : Blocks)
+        ConstantFoldTerminator(BB, /*DeleteDeadConditions=*/true);
+
+    // Eliminare o unire un blocco lo distrugge: non si può iterare su
+    // Blocks dopo
+    SmallVector<WeakVH, 16> Worklist(Blocks.begin(), Blocks.end());
+    while (true) {
+        SmallVector<BasicBlock *, 4> DeadBlocks;
+        for (WeakVH &V : Worklist) {
+            auto *BB = dyn_cast_or_null<BasicBlock>(V);
+            if (BB && BB != Entry && pred_empty(BB) && !is_contained(DeadBlocks, BB))
+                DeadBlocks.push_back(BB);
+        }
+        if (DeadBlocks.empty())
+            break;
+        for (BasicBlock *BB : DeadBlocks)
+            LI.removeBlock(BB);
+        DeleteDeadBlocks(DeadBlocks);
+    }
+    for (WeakVH &V : Worklist)
+        if (auto *BB = dyn_cast_or_null<BasicBlock>(V))
+            MergeBlockIntoPredecessor(BB, nullptr, &LI);
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "loopUnroll", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "loop_unroll") {
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
@@ -0,0 +1,61 @@
+#include <stdio.h>
+
+#define N 10
+#define M 1003
+
+int A[N], B[N], C[M];
+
+// Loop da 10 iterazioni come nei test della loop fusion, con 2 istruzioni
+// nell'header, 5 nel body e 2 nel latch: 10 * 9 = 90 restano entro la
+// soglia di 150 e il loop viene srotolato completamente, con i prodotti
+// con i che diventano costanti
+void test_full() {
+    for (int i = 0; i < N; i++) {
+        A[i] = i * 3;
+    }
+}
+
+// Stesso trip count ma circa 17 istruzioni per iterazione: 10 * 17 = 170
+// supera la soglia dello srotolamento completo, e il loop viene srotolato
+// per 8 (8 * 17 = 136) con le 2 iterazioni in eccesso eseguite prima. Le
+// soglie sono quelle di default del pass (150 per entrambi i casi): su
+// x86-64 il target non ne indica una più alta, e il budget parziale non
+// scende mai sotto il default
+int test_over_budget() {
+    int sum = 0;
+    for (int i = 0; i < N; i++) {
+        A[i] = i * 3;
+        sum += A[i] + B[i];
+    }
+    return sum;
+}
+
+// Trip count noto ma troppo grande: unrolling parziale, con le
+// M % fattore iterazioni in eccesso eseguite prima del loop
+void test_partial() {
+    for (int i = 0; i < M; i++) {
+        C[i] = C[i] * 2 + i;
+    }
+}
+
+// Trip count sconosciuto: ogni copia mantiene il controllo di uscita
+int test_runtime(int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += C[i] ^ i;
+    }
+    return sum;
+}
+
+int main() {
+    for (int i = 0; i < N; i++)
+        B[i] = i + 1;
+    for (int i = 0; i < M; i++)
+        C[i] = i % 13;
+    test_full();
+    int a = test_over_budget();
+    test_partial();
+    int b = test_runtime(M - 6);
+    printf("%d %d %d %d\n", A[N - 1], a, C[M - 1], b);
+    return 0;
+}
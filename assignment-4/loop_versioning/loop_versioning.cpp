@@ -0,0 +1,153 @@
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/LoopAccessAnalysis.h"
+#include "llvm/Transforms/Scalar/LoopPassManager.h"
+#include "llvm/Transforms/Scalar/LoopRotation.h"
+#include "llvm/Transforms/Utils/LoopSimplify.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/LoopVersioning.h"
+
+using namespace llvm;
+
+//-----------------------------------------------------------------------------
+// TestPass implementation
+//-----------------------------------------------------------------------------
+// Versioning dei loop con controlli di alias a runtime: quando i puntatori
+// usati nel loop potrebbero sovrapporsi, il preheader controlla a runtime
+// che gli intervalli di memoria siano disgiunti. Se lo sono si esegue il
+// loop originale, annotato con scope noalias (su cui code motion e loop
+// fusion possono lavorare), altrimenti una sua copia senza annotazioni.
+namespace {
+
+// Oltre questo numero di controlli il costo del test supera il guadagno
+static const unsigned MaxRuntimeChecks = 16;
+
+struct TestPass : PassInfoMixin<TestPass> {
+  // Main entry point per il nuovo Pass Manager
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM) {
+
+    errs() << "TestPass running on function: " << F.getName() << "\n";
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &LAIs = FAM.getResult<LoopAccessAnalysis>(F);
+
+    // Il versioning crea nuovi loop: la worklist va costruita prima
+    SmallVector<Loop *, 8> Worklist;
+    for (Loop *TopLevelLoop : LI) {
+        for (Loop *L : depth_first(TopLevelLoop)) {
+            if (L->isInnermost()) {
+                Worklist.push_back(L);
+            }
+        }
+    }
+
+    bool Changed = false;
+    for (Loop *L : Worklist) {
+        if (!isVersioningCandidate(L))
+            continue;
+
+        const LoopAccessInfo &LAI = LAIs.getInfo(*L);
+        if (!needsVersioning(LAI))
+            continue;
+
+        errs() << "Versioning loop " << L->getHeader()->getName() << " with "
+               << LAI.getNumRuntimePointerChecks() << " runtime checks.\n";
+
+        // I valori usati dopo il loop devono passare da PHI LCSSA, così il
+        // versioning può unire le due versioni nel blocco di uscita
+        formLCSSARecursively(*L, DT, &LI, &SE);
+
+        LoopVersioning LVer(LAI, LAI.getRuntimePointerChecking()->getChecks(),
+                            L, &LI, &DT, &SE);
+        LVer.versionLoop();
+        // La versione veloce (il loop originale) riceve gli scope noalias
+        LVer.annotateLoopWithNoAlias();
+
+        // Le informazioni di LAA non valgono più per i loop modificati
+        LAIs.clear();
+        Changed = true;
+    }
+
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+bool isVersioningCandidate(Loop *L) {
+        // LoopAccessAnalysis richiede loop in forma semplificata e ruotata, con
+        // un unico blocco di uscita
+        if (!L->isLoopSimplifyForm() || !L->isRotatedForm()) {
+            errs() << "Loop is not in simplified rotated form\n";
+            return false;
+        }
+        if (!L->getExitingBlock() || !L->getUniqueExitBlock()) {
+            errs() << "Loop has more than one exit\n";
+            return false;
+        }
+        return true;
+}
+
+bool needsVersioning(const LoopAccessInfo &LAI) {
+        if (LAI.hasConvergentOp()) {
+            errs() << "Loop contains convergent operations\n";
+            return false;
+        }
+
+        // Dipendenze certe non si risolvono con un controllo a runtime
+        if (!LAI.canVectorizeMemory()) {
+            errs() << "Memory dependences cannot be checked at runtime\n";
+            return false;
+        }
+
+        unsigned NumChecks = LAI.getNumRuntimePointerChecks();
+        if (NumChecks == 0 && LAI.getPSE().getPredicate().isAlwaysTrue()) {
+            errs() << "No runtime checks needed\n";
+            return false;
+        }
+        if (NumChecks > MaxRuntimeChecks) {
+            errs() << "Too many runtime checks (" << NumChecks << ")\n";
+            return false;
+        }
+        return true;
+}
+
+  static bool isRequired() { return true; }
+
+};
+
+
+//-----------------------------------------------------------------------------
+// New PM Registration
+//-----------------------------------------------------------------------------
+llvm::PassPluginLibraryInfo getTestPassPluginInfo() {
+  return {LLVM_PLUGIN_API_VERSION, "loopVersioning", LLVM_VERSION_STRING,
+          [](PassBuilder &PB) {
+            PB.registerPipelineParsingCallback(
+                [](StringRef Name, FunctionPassManager &FPM,
+                   ArrayRef<PassBuilder::PipelineElement>) {
+                  if (Name == "loop_versioning") {
+                    // LoopAccessAnalysis lavora solo su loop ruotati
+                    FPM.addPass(LoopSimplifyPass());
+                    FPM.addPass(createFunctionToLoopPassAdaptor(LoopRotatePass()));
+                    FPM.addPass(TestPass());
+                    return true;
+                  }
+                  return false;
+                });
+          }};
+}
+
+// Core interface for pass plugins. Enables 'opt' to recognize TestPass.
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo
+llvmGetPassPluginInfo() {
+  return getTestPassPluginInfo();
+}
+
+} // namespace
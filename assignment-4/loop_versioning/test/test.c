@@ -0,0 +1,35 @@
+#include <stdio.h>
+
+// a, b e c potrebbero sovrapporsi: senza controlli a runtime il compilatore
+// deve assumere il caso peggiore
+void test_saxpy(float *a, float *b, float *c, float k, int n) {
+    for (int i = 0; i < n; i++) {
+        c[i] = k * a[i] + b[i];
+    }
+}
+
+// Due loop sugli stessi puntatori: nella versione noalias diventano fusibili
+void test_two_loops(float *a, float *b, int n) {
+    for (int i = 0; i < n; i++) {
+        a[i] = a[i] * 2.0f;
+    }
+    for (int i = 0; i < n; i++) {
+        b[i] = a[i] + 1.0f;
+    }
+}
+
+int main() {
+    float a[16], b[16], c[16];
+    for (int i = 0; i < 16; i++) {
+        a[i] = i;
+        b[i] = 16 - i;
+    }
+
+    test_saxpy(a, b, c, 2.0f, 16);
+    // Puntatori sovrapposti: deve essere eseguita la versione originale
+    test_saxpy(a, a + 1, a + 2, 2.0f, 8);
+    test_two_loops(a, b, 16);
+
+    printf("%f %f %f\n", a[3], b[3], c[3]);
+    return 0;
+}